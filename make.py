@@ -7,7 +7,7 @@ p.add_argument('-c', '--compiler', help='Compiler', choices=['cc', 'gcc', 'clang
 p.add_argument('-o', '--output', help='Output file', default='')
 p.add_argument('-d', '--debug', action='store_true', help='Debug compile')
 p.add_argument('-s', '--static', action='store_true', help='Static compile')
-p.add_argument('-p', '--task', help='Task to run', choices=['main', 'test', 'engine'], default='main')
+p.add_argument('-p', '--task', help='Task to run', choices=['main', 'lib', 'test', 'engine', 'containers'], default='main')
 args = p.parse_args()
 
 # Determine flags for: compilation, warning, and linking
@@ -21,14 +21,19 @@ def run(cmd):
     return os.system(cmd)
 
 def compile(program, output):
-    sources = 'src/bitboard.c src/gen.c src/position.c src/str.c src/util.c src/vec.c'
-    if program == 'main':
-        sources += ' src/engine.c src/game.c src/jobs.c src/main.c src/openings.c src/options.c' \
-            ' src/seqwriter.c src/sprt.c src/workers.c'
+    sources = 'src/bitboard.c src/gen.c src/memstats.c src/position.c src/str.c src/util.c src/vec.c'
+    flags = cflags
+    if program in ['main', 'lib']:
+        sources += ' src/adjsim.c src/adjudicator.c src/balance.c src/engine.c src/game.c src/gamedb.c src/heap.c src/hmap.c src/jobs.c src/match.c src/numa.c src/openings.c src/options.c' \
+            ' src/perf.c src/ring.c src/seqwriter.c src/spsa.c src/sprt.c src/workers.c'
+        sources += ' src/main.c' if program == 'main' else ' src/cccli.c'
+        if program == 'lib': flags += ' -fPIC -shared -fvisibility=hidden'
     elif program == 'engine':
         sources += ' test/engine.c'
+    elif program == 'containers':
+        sources += ' src/heap.c src/hmap.c src/ring.c test/containers.c'
 
-    return run('{} {} {} {} -o {} {}'.format(args.compiler, cflags, wflags, sources, output, lflags))
+    return run('{} {} {} {} -o {} {}'.format(args.compiler, flags, wflags, sources, output, lflags))
 
 if args.task == 'test':
     if compile('engine', './test/engine') == 0 and compile('main', './c-chess-cli') == 0:
@@ -55,6 +60,15 @@ elif args.task == 'main':
     if args.output == '': args.output = './c-chess-cli'
     compile(args.task, args.output)
 
+elif args.task == 'lib':
+    if args.output == '': args.output = './libc-chess-cli.so'
+    compile(args.task, args.output)
+
 elif args.task == 'engine':
     if args.output == '': args.output = './test/engine'
     compile(args.task, args.output)
+
+elif args.task == 'containers':
+    if args.output == '': args.output = './test/containers'
+    if compile(args.task, args.output) == 0:
+        run(args.output)
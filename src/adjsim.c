@@ -0,0 +1,299 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adjsim.h"
+#include "bitboard.h"
+#include "util.h"
+#include "vec.h"
+#include "workers.h"
+
+// Game replayed by the simulator: what the adjudication rules see at each ply
+typedef struct {
+    int *scores;  // score of each ply, from the pov of the side to move
+    int64_t *times;  // time spent on each ply (in ms), 0 if not recorded
+    int turn;  // color to move at ply 0
+    int result;  // RESULT_xxx from white's pov
+} AdjGame;
+
+// Outcome of one candidate (pair of rules) over all games
+typedef struct {
+    const AdjRule *resign, *draw;  // NULL if not used
+    int adjudicated, wrong;  // number of games adjudicated, and of those with a different result
+    int64_t plies, time;  // plies and time (in ms) saved
+} AdjCandidate;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    AdjGame *games;
+    AdjCandidate *candidates;
+    size_t next;  // next candidate to evaluate
+} AdjSim;
+
+AdjSimParam adjsim_param_init(void)
+{
+    return (AdjSimParam){
+        .pgn = str_init(),
+        .resign = vec_init(AdjRule),
+        .draw = vec_init(AdjRule)
+    };
+}
+
+void adjsim_param_destroy(AdjSimParam *ap)
+{
+    str_destroy(&ap->pgn);
+    vec_destroy(ap->resign);
+    vec_destroy(ap->draw);
+}
+
+bool adjsim_parse_rule(const char *s, AdjRule *r)
+// Parse "COUNT,SCORE"
+{
+    return sscanf(s, "%d,%d", &r->count, &r->score) == 2 && r->count > 0 && r->score >= 0;
+}
+
+static bool adjsim_parse_comment(const char *s, int *score, int64_t *time)
+// Parse a PGN comment written by game_export_pgn() with verbosity 2 or 3: "score/depth[ timems]",
+// where score is in cp, or "M<n>" / "-M<n>" for mate scores.
+{
+    const bool negative = *s == '-';
+    s += negative;
+    const bool mate = *s == 'M';
+    s += mate;
+
+    char *end = NULL;
+    const long n = strtol(s, &end, 10);
+
+    if (end == s || *end != '/')
+        return false;
+
+    *score = !mate ? (negative ? -(int)n : (int)n)
+        : negative ? INT_MIN + (int)n : INT_MAX - (int)n;
+
+    // Skip depth. Time is optional (verbosity 2).
+    strtol(end + 1, &end, 10);
+    *time = *end == ' ' ? atoll(end + 1) : 0;
+    return true;
+}
+
+static void adjsim_game_destroy(AdjGame *g)
+{
+    vec_destroy(g->scores);
+    vec_destroy(g->times);
+}
+
+static AdjGame *adjsim_load(const char *fileName, int *skipped)
+// Read the games of a PGN file, keeping only those whose scores were recorded
+{
+    FILE *in = fopen(fileName, "re");
+    DIE_IF(0, !in);
+
+    AdjGame *games = vec_init(AdjGame);
+    scope(str_destroy) str_t line = str_init(), token = str_init();
+    AdjGame g = {0};
+    bool inMoves = false;  // reading movetext (a tag ends the previous game)
+    *skipped = 0;
+
+    while (true) {
+        const bool eof = !str_getline(&line, in);
+        const char *tail = NULL;
+
+        // End of game: keep it if it has scores and a result
+        if (eof || (inMoves && line.buf[0] == '[')) {
+            if (vec_size(g.scores) && g.result < NB_RESULT)
+                vec_push(games, g);
+            else {
+                (*skipped) += inMoves;
+                adjsim_game_destroy(&g);
+            }
+
+            g = (AdjGame){0};
+            inMoves = false;
+
+            if (eof)
+                break;
+        }
+
+        if (!g.scores)
+            g = (AdjGame){.scores = vec_init(int), .times = vec_init(int64_t), .turn = WHITE,
+                .result = NB_RESULT};
+
+        if ((tail = str_prefix(line.buf, "[Result \""))) {
+            g.result = str_prefix(tail, "1-0\"") ? RESULT_WIN
+                : str_prefix(tail, "0-1\"") ? RESULT_LOSS
+                : str_prefix(tail, "1/2-1/2\"") ? RESULT_DRAW
+                : NB_RESULT;
+        } else if ((tail = str_prefix(line.buf, "[FEN \""))) {
+            // Second field of the FEN is the color to move
+            str_tok(str_tok(tail, &token, " "), &token, " ");
+            g.turn = !strcmp(token.buf, "b") ? BLACK : WHITE;
+        } else if (line.buf[0] != '[' && line.len) {
+            inMoves = true;
+
+            // Each move is followed by its comment
+            for (const char *c = strchr(line.buf, '{'); c; c = strchr(c + 1, '{')) {
+                int score = 0;
+                int64_t time = 0;
+
+                if (adjsim_parse_comment(c + 1, &score, &time)) {
+                    vec_push(g.scores, score);
+                    vec_push(g.times, time);
+                }
+            }
+        }
+    }
+
+    DIE_IF(0, fclose(in) < 0);
+    return games;
+}
+
+static int adjsim_replay(const AdjGame *g, const AdjRule *resign, const AdjRule *draw, int *result)
+// Apply the adjudication rules of game_play() to the recorded scores. Returns the ply where the game
+// would have been adjudicated (and its *result from white's pov), or -1 if none.
+{
+    int drawPlyCount = 0, resignCount[NB_COLOR] = {0};
+
+    for (int ply = 0; ply < (int)vec_size(g->scores); ply++) {
+        const int color = g->turn ^ (ply % 2), score = g->scores[ply];
+
+        if (draw && abs(score) <= draw->score) {
+            if (++drawPlyCount >= 2 * draw->count) {
+                *result = RESULT_DRAW;
+                return ply;
+            }
+        } else
+            drawPlyCount = 0;
+
+        if (resign && score <= -resign->score) {
+            if (++resignCount[color] >= resign->count) {
+                *result = color == WHITE ? RESULT_LOSS : RESULT_WIN;
+                return ply;
+            }
+        } else
+            resignCount[color] = 0;
+    }
+
+    return -1;
+}
+
+static void *adjsim_thread_start(void *arg)
+{
+    AdjSim *as = arg;
+
+    while (true) {
+        pthread_mutex_lock(&as->mtx);
+        const size_t i = as->next++;
+        pthread_mutex_unlock(&as->mtx);
+
+        if (i >= vec_size(as->candidates))
+            break;
+
+        // Each candidate is evaluated by one thread: no lock needed
+        AdjCandidate *c = &as->candidates[i];
+
+        for (size_t j = 0; j < vec_size(as->games); j++) {
+            const AdjGame *g = &as->games[j];
+            int result = NB_RESULT;
+            const int ply = adjsim_replay(g, c->resign, c->draw, &result);
+
+            if (ply < 0)
+                continue;
+
+            c->adjudicated++;
+            c->wrong += result != g->result;
+
+            // The search at 'ply' is still played, the rest of the game is saved
+            for (size_t k = (size_t)ply + 1; k < vec_size(g->scores); k++) {
+                c->plies++;
+                c->time += g->times[k];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void adjsim_format_rule(const AdjRule *r, str_t *out)
+{
+    if (r)
+        str_cpy_fmt(out, "%i,%i", r->count, r->score);
+    else
+        str_cpy_c(out, "-");
+}
+
+void adjsim_run(const AdjSimParam *ap, int threads)
+// Evaluate every candidate: each resign rule (or none) with each draw rule (or none). Report, for
+// each, the plies and time saved, versus the number of games whose result was changed.
+{
+    int skipped = 0;
+    AdjSim as = {.games = adjsim_load(ap->pgn.buf, &skipped)};
+    pthread_mutex_init(&as.mtx, NULL);
+    as.candidates = vec_init(AdjCandidate);
+
+    if (!vec_size(as.games))
+        DIE("No games with scores in '%s' (use -pgn FILE 2 or 3)\n", ap->pgn.buf);
+
+    for (size_t r = 0; r <= vec_size(ap->resign); r++)
+        for (size_t d = 0; d <= vec_size(ap->draw); d++)
+            if (r || d)
+                vec_push(as.candidates, ((AdjCandidate){
+                    .resign = r ? &ap->resign[r - 1] : NULL,
+                    .draw = d ? &ap->draw[d - 1] : NULL
+                }));
+
+    pthread_t *t = calloc((size_t)threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&t[i], NULL, adjsim_thread_start, &as);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(t[i], NULL);
+
+    // Totals, to express savings as a percentage
+    int64_t plies = 0, time = 0;
+
+    for (size_t j = 0; j < vec_size(as.games); j++)
+        for (size_t k = 0; k < vec_size(as.games[j].scores); k++) {
+            plies++;
+            time += as.games[j].times[k];
+        }
+
+    const size_t n = vec_size(as.games);
+    printf("Adjudication simulation: %zu games, %" PRId64 " plies, %" PRId64 "ms (%d skipped "
+        "without scores or result)\n", n, plies, time, skipped);
+    printf("%-12s %-12s %12s %16s %8s %8s\n", "resign", "draw", "adjudicated", "wrong results",
+        "plies", "time");
+
+    scope(str_destroy) str_t resign = str_init(), draw = str_init();
+
+    for (size_t i = 0; i < vec_size(as.candidates); i++) {
+        const AdjCandidate *c = &as.candidates[i];
+        adjsim_format_rule(c->resign, &resign);
+        adjsim_format_rule(c->draw, &draw);
+
+        printf("%-12s %-12s %11.1f%% %6d (%6.2f%%) %7.1f%% %7.1f%%\n", resign.buf, draw.buf,
+            100.0 * c->adjudicated / (double)n, c->wrong, 100.0 * c->wrong / (double)n,
+            100.0 * (double)c->plies / (double)plies,
+            time ? 100.0 * (double)c->time / (double)time : 0.0);
+    }
+
+    free(t);
+    vec_destroy(as.candidates);
+    vec_destroy_rec(as.games, adjsim_game_destroy);
+    pthread_mutex_destroy(&as.mtx);
+}
@@ -0,0 +1,34 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <stdbool.h>
+#include "str.h"
+
+// Adjudication rule, as in -resign and -draw: COUNT consecutive moves, SCORE in cp
+typedef struct {
+    int count, score;
+} AdjRule;
+
+// Replay recorded games with candidate rules (each resign rule with each draw rule)
+typedef struct {
+    str_t pgn;  // games played with PGN verbosity 2 or 3 (scores, and times if 3)
+    AdjRule *resign, *draw;
+} AdjSimParam;
+
+AdjSimParam adjsim_param_init(void);
+void adjsim_param_destroy(AdjSimParam *ap);
+
+bool adjsim_parse_rule(const char *s, AdjRule *r);
+void adjsim_run(const AdjSimParam *ap, int threads);
@@ -0,0 +1,232 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include "adjudicator.h"
+#include "bitboard.h"
+#include "engine.h"
+#include "ring.h"
+#include "util.h"
+#include "vec.h"
+
+AdjudicatorParam adjudicator_param_init(void)
+{
+    return (AdjudicatorParam){
+        .cmd = str_init(),
+        .options = vec_init(str_t),
+        .nodes = 100000,
+        .timeout = 10000,
+        .pool = 1,
+        .every = 2,
+        .count = 3
+    };
+}
+
+void adjudicator_param_destroy(AdjudicatorParam *ap)
+{
+    str_destroy(&ap->cmd);
+    vec_destroy_rec(ap->options, str_destroy);
+}
+
+static void *adjudicator_thread_start(void *arg)
+{
+    Adjudicator *a = arg;
+
+    pthread_mutex_lock(&a->mtx);
+    Worker *w = &a->workers[a->started++];
+    pthread_mutex_unlock(&a->mtx);
+
+    Engine e = engine_init(w, a->ap->cmd.buf, "", a->ap->options);
+    bool chess960 = false;
+
+    scope(str_destroy) str_t position = str_init(), go = str_init(), best = str_init(),
+        pv = str_init();
+    str_cpy_fmt(&go, "go nodes %I", a->ap->nodes);
+
+    while (true) {
+        pthread_mutex_lock(&a->mtx);
+
+        while (!a->stop && !ring_size(a->queue))
+            pthread_cond_wait(&a->cond, &a->mtx);
+
+        if (a->stop) {
+            pthread_mutex_unlock(&a->mtx);
+            break;
+        }
+
+        // Take the oldest request, and copy what we need (the worker may reuse it once cancelled)
+        AdjRequest *r = &a->requests[ring_pop(a->queue)];
+        r->state = ADJ_RUNNING;
+        const uint64_t ticket = r->ticket;
+        const int turn = r->turn;
+        const bool requestChess960 = r->chess960;
+        str_cpy(&position, r->position);
+
+        pthread_mutex_unlock(&a->mtx);
+
+        if (requestChess960 != chess960) {
+            chess960 = requestChess960;
+            engine_writeln(w, &e, chess960 ? "setoption name UCI_Chess960 value true"
+                : "setoption name UCI_Chess960 value false");
+        }
+
+        engine_writeln(w, &e, position.buf);
+        engine_sync(w, &e);
+        engine_writeln(w, &e, go.buf);
+
+        // Nodes limit, with a time limit in case the engine does not respect it. Beyond timeout,
+        // the search is stopped (its bestmove is skipped by the next engine_sync) and the result
+        // discarded: the game submits a later position. Beyond timeout + 1s, the engine is deemed
+        // unresponsive (see match_monitor).
+        int64_t timeLeft = a->ap->timeout;
+        Info info = {0};
+        const bool ok = engine_bestmove(w, &e, &timeLeft, &best, &pv, &info, NULL);
+
+        if (!ok)
+            engine_writeln(w, &e, "stop");
+
+        pthread_mutex_lock(&a->mtx);
+
+        if (r->ticket == ticket) {
+            r->score = turn == WHITE ? info.score : -info.score;
+            r->state = ok ? ADJ_DONE : ADJ_IDLE;
+        }
+
+        pthread_mutex_unlock(&a->mtx);
+    }
+
+    engine_destroy(w, &e);
+
+    pthread_mutex_lock(&a->mtx);
+    a->finished++;
+    pthread_mutex_unlock(&a->mtx);
+    return NULL;
+}
+
+Adjudicator adjudicator_init(const AdjudicatorParam *ap, Worker *workers, int requests)
+// Start ap->pool engine processes, each driven by its own thread, using workers[0..pool-1]. Players
+// of worker id submit their requests in requests[id - 1].
+{
+    Adjudicator a = {.ap = ap, .workers = workers, .nbRequests = requests};
+    pthread_mutex_init(&a.mtx, NULL);
+    pthread_cond_init(&a.cond, NULL);
+    a.queue = ring_init((size_t)requests, int);
+    a.requests = calloc((size_t)requests, sizeof(AdjRequest));
+
+    for (int i = 0; i < requests; i++)
+        a.requests[i].position = str_init();
+
+    return a;
+}
+
+void adjudicator_start(Adjudicator *a)
+// Separate from adjudicator_init(): threads need the final address of 'a'
+{
+    a->threads = calloc((size_t)a->ap->pool, sizeof(pthread_t));
+
+    for (int i = 0; i < a->ap->pool; i++)
+        pthread_create(&a->threads[i], NULL, adjudicator_thread_start, a);
+}
+
+void adjudicator_destroy(Adjudicator *a)
+// Stop the engine threads (after their current evaluation, if any). Their deadlines are enforced
+// until they finish, as the main thread no longer monitors them at this point.
+{
+    pthread_mutex_lock(&a->mtx);
+    a->stop = true;
+    pthread_cond_broadcast(&a->cond);
+
+    while (a->finished < a->ap->pool) {
+        pthread_mutex_unlock(&a->mtx);
+        system_sleep(100);
+
+        for (int i = 0; i < a->ap->pool; i++)
+            if (deadline_overdue(&a->workers[i]) > 1000)
+                DIE("[%d] engine %s is unresponsive\n", a->workers[i].id,
+                    a->workers[i].deadline.engineName.buf);
+
+        pthread_mutex_lock(&a->mtx);
+    }
+
+    pthread_mutex_unlock(&a->mtx);
+
+    for (int i = 0; i < a->ap->pool; i++)
+        pthread_join(a->threads[i], NULL);
+
+    for (int i = 0; i < a->nbRequests; i++)
+        str_destroy(&a->requests[i].position);
+
+    free(a->threads);
+    free(a->requests);
+    ring_destroy(a->queue);
+    pthread_cond_destroy(&a->cond);
+    pthread_mutex_destroy(&a->mtx);
+}
+
+bool adjudicator_submit(Adjudicator *a, int workerId, const str_t *position, int turn,
+    bool chess960)
+// Queue an evaluation of 'position', unless the worker's previous request is still pending, or its
+// result has not been collected yet. Returns true if queued.
+{
+    pthread_mutex_lock(&a->mtx);
+    AdjRequest *r = &a->requests[workerId - 1];
+    const bool idle = r->state == ADJ_IDLE;
+
+    if (idle) {
+        str_cpy(&r->position, *position);
+        r->turn = turn;
+        r->chess960 = chess960;
+        r->state = ADJ_QUEUED;
+        ring_push(a->queue, workerId - 1);
+        pthread_cond_signal(&a->cond);
+    }
+
+    pthread_mutex_unlock(&a->mtx);
+    return idle;
+}
+
+bool adjudicator_poll(Adjudicator *a, int workerId, int *score)
+// Collect the result of the worker's request, if it is ready (never blocks)
+{
+    pthread_mutex_lock(&a->mtx);
+    AdjRequest *r = &a->requests[workerId - 1];
+    const bool done = r->state == ADJ_DONE;
+
+    if (done) {
+        *score = r->score;
+        r->state = ADJ_IDLE;
+    }
+
+    pthread_mutex_unlock(&a->mtx);
+    return done;
+}
+
+void adjudicator_cancel(Adjudicator *a, int workerId)
+// Forget the worker's request (at the end of a game): remove it from the queue, or discard its
+// result when the evaluation in progress completes.
+{
+    pthread_mutex_lock(&a->mtx);
+    AdjRequest *r = &a->requests[workerId - 1];
+
+    if (r->state == ADJ_QUEUED)
+        for (size_t i = 0; i < ring_size(a->queue); i++)
+            if (ring_at(a->queue, i) == workerId - 1) {
+                ring_remove(a->queue, i);
+                break;
+            }
+
+    r->ticket++;
+    r->state = ADJ_IDLE;
+    pthread_mutex_unlock(&a->mtx);
+}
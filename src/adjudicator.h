@@ -0,0 +1,73 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include "str.h"
+#include "workers.h"
+
+// Adjudicator engine pool settings (-adjudicator)
+typedef struct {
+    str_t cmd, *options;  // engine command, and UCI options ("name=value" strings)
+    int64_t nodes;  // node limit per evaluation
+    int64_t timeout;  // time limit per evaluation (ms): beyond, the result is discarded
+    int pool;  // number of engine processes, shared by all workers
+    int every;  // submit the current position every N plies
+    int count;  // number of consecutive evaluations needed to adjudicate
+    int resignScore;  // decisive if the score is at least resignScore (0 = disabled)
+    int drawScore;  // drawish if the score is within +/-drawScore (0 = disabled)
+    char pad[4];
+} AdjudicatorParam;
+
+enum {ADJ_IDLE, ADJ_QUEUED, ADJ_RUNNING, ADJ_DONE};
+
+// Evaluation requested by a worker (at most one at a time)
+typedef struct {
+    str_t position;  // UCI position command
+    uint64_t ticket;  // changes when cancelled, so that late results are discarded
+    int score;  // result, from white's pov
+    int state;  // ADJ_xxx
+    int turn;  // color to move in 'position'
+    bool chess960;
+    char pad[3];
+} AdjRequest;
+
+typedef struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    const AdjudicatorParam *ap;
+    AdjRequest *requests;  // requests[workerId - 1]
+    int *queue;  // ring of indices of queued requests, in order (at most one per worker)
+    Worker *workers;  // one per engine process (for deadlines and logs)
+    pthread_t *threads;
+    int nbRequests;
+    int started;  // number of threads started (to assign workers)
+    int finished;  // number of threads finished (after stop)
+    bool stop;
+    char pad[3];
+} Adjudicator;
+
+AdjudicatorParam adjudicator_param_init(void);
+void adjudicator_param_destroy(AdjudicatorParam *ap);
+
+Adjudicator adjudicator_init(const AdjudicatorParam *ap, Worker *workers, int requests);
+void adjudicator_start(Adjudicator *a);
+void adjudicator_destroy(Adjudicator *a);
+
+bool adjudicator_submit(Adjudicator *a, int workerId, const str_t *position, int turn,
+    bool chess960);
+bool adjudicator_poll(Adjudicator *a, int workerId, int *score);
+void adjudicator_cancel(Adjudicator *a, int workerId);
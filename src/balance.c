@@ -0,0 +1,181 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include "balance.h"
+#include "engine.h"
+#include "position.h"
+#include "util.h"
+#include "vec.h"
+#include "workers.h"
+
+// State shared by all threads during the evaluation pass
+static struct {
+    pthread_mutex_t mtx;
+    Openings *o;
+    const BalanceParam *bp;
+    const char *cmd, *name;
+    const str_t *engineOptions;
+    int *scores;  // scores[i] = eval of the i-th opening (in cp, from white's pov)
+    size_t next, count;
+} B;
+
+static bool balance_pop(size_t *i)
+{
+    pthread_mutex_lock(&B.mtx);
+    const bool ok = B.next < B.count;
+
+    if (ok)
+        *i = B.next++;
+
+    pthread_mutex_unlock(&B.mtx);
+    return ok;
+}
+
+static void *balance_thread_start(void *arg)
+{
+    Worker *w = arg;
+    Engine e = engine_init(w, B.cmd, B.name, B.engineOptions);
+    scope(str_destroy) str_t fen = str_init(), cmd = str_init(), best = str_init(), pv = str_init();
+    bool chess960 = false;
+    size_t i = 0;
+
+    while (balance_pop(&i)) {
+        openings_next(B.o, &fen, i, w->id);
+        Position pos;
+
+        if (!pos_set(&pos, fen.buf, false, NULL))
+            DIE("[%d] illegal FEN '%s'\n", w->id, fen.buf);
+
+        if (pos.chess960 && !chess960) {
+            if (!e.supportChess960)
+                DIE("[%d] '%s' does not support Chess960\n", w->id, e.name.buf);
+
+            engine_writeln(w, &e, "setoption name UCI_Chess960 value true");
+            chess960 = true;
+        }
+
+        engine_writeln(w, &e, "ucinewgame");
+        str_cpy_fmt(&cmd, "position fen %S", fen);
+        engine_writeln(w, &e, cmd.buf);
+        engine_sync(w, &e);
+
+        str_cpy_fmt(&cmd, "go nodes %I", B.bp->nodes);
+        engine_writeln(w, &e, cmd.buf);
+
+        Info info = {0};
+        int64_t timeLeft = INT64_MAX / 2;  // HACK: system_msec() + timeLeft must not overflow
+        engine_bestmove(w, &e, &timeLeft, &best, &pv, &info, NULL);
+
+        // Mate scores are clamped, so they can be negated safely
+        const int clamped = min(info.score, INT_MAX / 2);
+        const int score = max(clamped, -INT_MAX / 2);
+        B.scores[i] = pos.turn == WHITE ? score : -score;
+    }
+
+    engine_destroy(w, &e);
+    return NULL;
+}
+
+static bool balance_load(const char *cacheName, const char *header, int *scores, size_t n)
+{
+    FILE *in = fopen(cacheName, "re");
+
+    if (!in)
+        return false;
+
+    scope(str_destroy) str_t line = str_init();
+    bool ok = str_getline(&line, in) && !strcmp(line.buf, header);
+    size_t i = 0;
+
+    for (; ok && str_getline(&line, in); i++)
+        if (i < n)
+            scores[i] = atoi(line.buf);
+
+    DIE_IF(0, fclose(in) < 0);
+    return ok && i == n;
+}
+
+static void balance_save(const char *cacheName, const char *header, const int *scores, size_t n)
+{
+    FILE *out = fopen(cacheName, "we");
+    DIE_IF(0, !out);
+    DIE_IF(0, fprintf(out, "%s\n", header) < 0);
+
+    for (size_t i = 0; i < n; i++)
+        DIE_IF(0, fprintf(out, "%d\n", scores[i]) < 0);
+
+    DIE_IF(0, fclose(out) < 0);
+}
+
+void balance_filter(Openings *o, const BalanceParam *bp, const char *cmd, const char *name,
+    const str_t *engineOptions, const char *cacheName, int concurrency, FILE *out)
+// Evaluate every opening with the reference engine, using Workers[0..concurrency-1], and keep only
+// the ones whose score is within [bp->min, bp->max]. Scores are cached in 'cacheName', so that the
+// evaluation pass is only done once for a given book (content hash), engine, options, and node
+// count.
+{
+    const size_t n = openings_count(o);
+    int *scores = calloc(n, sizeof(int));
+
+    scope(str_destroy) str_t header = str_init();
+    str_cpy_fmt(&header, "%s nodes=%I book=%U", cmd, bp->nodes, (uintmax_t)openings_hash(o, 0));
+
+    for (size_t i = 0; i < vec_size(engineOptions); i++)
+        str_cat_fmt(&header, " option.%S", engineOptions[i]);
+
+    if (!balance_load(cacheName, header.buf, scores, n)) {
+        fprintf(out, "Balance: evaluating %zu openings\n", n);
+
+        B.o = o;
+        B.bp = bp;
+        B.cmd = cmd;
+        B.name = name;
+        B.engineOptions = engineOptions;
+        B.scores = scores;
+        B.next = 0;
+        B.count = n;
+        pthread_mutex_init(&B.mtx, NULL);
+
+        const size_t threadCount = (size_t)concurrency;
+        pthread_t threads[threadCount];
+
+        for (size_t i = 0; i < threadCount; i++)
+            pthread_create(&threads[i], NULL, balance_thread_start, &Workers[i]);
+
+        for (size_t i = 0; i < threadCount; i++)
+            pthread_join(threads[i], NULL);
+
+        pthread_mutex_destroy(&B.mtx);
+        balance_save(cacheName, header.buf, scores, n);
+    }
+
+    bool *keep = calloc(n, sizeof(bool));
+    size_t kept = 0;
+
+    for (size_t i = 0; i < n; i++)
+        kept += (keep[i] = bp->min <= scores[i] && scores[i] <= bp->max);
+
+    if (!kept)
+        DIE("Balance: no opening within [%d,%d]\n", bp->min, bp->max);
+
+    fprintf(out, "Balance: kept %zu of %zu openings within [%d,%d]\n", kept, n, bp->min,
+        bp->max);
+    openings_filter(o, keep);
+
+    free(keep);
+    free(scores);
+}
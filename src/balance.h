@@ -0,0 +1,27 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include "openings.h"
+
+typedef struct {
+    int64_t nodes;  // node limit per evaluation
+    int engine;  // index of the reference engine (starts at 0)
+    int min, max;  // eval window, in cp from white's pov
+    char pad[4];
+} BalanceParam;
+
+void balance_filter(Openings *o, const BalanceParam *bp, const char *cmd, const char *name,
+    const str_t *engineOptions, const char *cacheName, int concurrency, FILE *out);
@@ -0,0 +1,132 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <pthread.h>
+#include <stdio.h>
+#include "cccli.h"
+#include "match.h"
+#include "memstats.h"
+#include "options.h"
+#include "util.h"
+#include "vec.h"
+
+struct CCCMatch {
+    Options options;
+    EngineOptions *eo;
+    pthread_t monitor;  // enforces deadlines, as the main thread of the program does
+};
+
+static CCCMatch *current;
+static char lastError[256];  // reason why the last ccc_match_create() failed
+
+static void *monitor_start(void *arg)
+{
+    (void)arg;
+    match_monitor();
+    return NULL;
+}
+
+int ccc_api_version(void)
+{
+    return CCC_API_VERSION;
+}
+
+const char *ccc_last_error(void)
+{
+    return lastError;
+}
+
+static void ccc_match_free(CCCMatch *m)
+{
+    options_destroy(&m->options);
+    vec_destroy_rec(m->eo, engine_options_destroy);
+    free(m);
+}
+
+CCCMatch *ccc_match_create(int argc, const char **argv)
+// Start a match, with the same command line options as the program (argv[0] is ignored). Its first
+// batch of games is the one given by the options (-rounds, -games). Engines are started by worker
+// threads, when they need them. Returns NULL if a match already exists, or if the options are
+// invalid (see ccc_last_error()).
+{
+    if (current) {
+        snprintf(lastError, sizeof(lastError), "Library: a match already exists\n");
+        return NULL;
+    }
+
+    CCCMatch *m = calloc(1, sizeof(CCCMatch));
+    m->eo = vec_init(EngineOptions);
+    m->options = options_init();
+
+    if (!options_try_parse(argc, argv, &m->options, &m->eo, lastError, sizeof(lastError))) {
+        ccc_match_free(m);
+        return NULL;
+    }
+
+    if (m->options.serveParam.port || m->options.sprtSim || m->options.query.file.len
+            || m->options.adjSimParam.pgn.len || vec_size(m->options.merge)) {
+        snprintf(lastError, sizeof(lastError),
+            "Library: -serve, -sprtsim, -query, -adjsim, and -merge do not play games\n");
+        ccc_match_free(m);
+        return NULL;
+    }
+
+    lastError[0] = '\0';
+    current = m;
+    MemStats = m->options.memStats >= 0;
+    match_init(&m->options, m->eo, true);
+    match_start();
+    pthread_create(&m->monitor, NULL, monitor_start, NULL);
+    return m;
+}
+
+void ccc_match_destroy(CCCMatch *m)
+// Shut down: games in progress are completed (and written to files), those not started are discarded
+{
+    if (!m || m != current)
+        return;
+
+    match_stop();
+    pthread_join(m->monitor, NULL);
+    match_join();
+
+    if (MemStats)
+        memstats_print(stderr);
+
+    match_destroy();
+    ccc_match_free(m);
+    current = NULL;
+}
+
+size_t ccc_match_submit(CCCMatch *m, int rounds)
+// Submit more rounds, played with the same engines, openings, and options. Returns the number of
+// games added (0 for a race, whose stages are decided as it goes).
+{
+    return m == current && rounds > 0 ? match_submit(rounds) : 0;
+}
+
+int ccc_match_poll(CCCMatch *m, CCCResult *r, int wait)
+// Read the next game result, in order of completion. If wait is non zero, block until a game is
+// played, unless all the games submitted so far are already read (or discarded, when SPRT stops the
+// match). Returns 1 if *r was written, 0 otherwise.
+{
+    return m == current && match_poll(r, wait);
+}
+
+size_t ccc_match_read_samples(CCCMatch *m, char *buf, size_t size)
+// Read at most size bytes of samples (-sample), in the format of the sample file, as with read().
+// Samples of a game are available when its result is.
+{
+    return m == current ? match_read_samples(buf, size) : 0;
+}
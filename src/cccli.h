@@ -0,0 +1,57 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Library API (libc-chess-cli.so, built by 'make.py -p lib'): a host program plays matches in process,
+// reusing engines, openings, and worker threads from one batch of games to the next, and reads results
+// and samples from memory, rather than parsing the output of the c-chess-cli program.
+//
+// - Only one match can exist at a time.
+// - Invalid options are not fatal: ccc_match_create() returns NULL, and ccc_last_error() says why.
+//   Errors once the match is created remain fatal, as in the program (a message is printed on
+//   stderr, and the process exits): files that cannot be opened, read, or written (-openings, -pgn,
+//   ...), engines that fail to start, crash, time out, or play an illegal move, and system errors.
+// - Files requested by the options (-pgn, -gamedb, -results, ...) are still written, but -sample
+//   only goes to memory. The summary lines of each game are not printed.
+// - stdout is left to the host: all other reports (SPRT, Swiss standings, race stages, SPSA
+//   iterations, -balance, -numa, -perf, -memstats) and warnings go to stderr.
+
+#define CCC_API_VERSION 2  // incremented when the ABI changes
+
+#define CCC_API __attribute__ ((visibility("default")))
+
+typedef struct CCCMatch CCCMatch;  // opaque
+
+// Outcome of a game (fixed layout)
+typedef struct {
+    uint64_t idx;  // game number (starts at 0, in job order)
+    int32_t round, game;  // round, and game number in the round (start at 0)
+    int32_t white, black;  // engine index (in the order of -engine)
+    int32_t result;  // 0: black wins, 1: draw, 2: white wins
+    int32_t ply;  // number of plies played
+    char reason[32];  // termination, as in the PGN ("checkmate", "adjudication", etc.)
+} CCCResult;
+
+CCC_API int ccc_api_version(void);
+CCC_API const char *ccc_last_error(void);  // why the last ccc_match_create() failed ("" otherwise)
+
+CCC_API CCCMatch *ccc_match_create(int argc, const char **argv);
+CCC_API void ccc_match_destroy(CCCMatch *m);
+
+CCC_API size_t ccc_match_submit(CCCMatch *m, int rounds);
+CCC_API int ccc_match_poll(CCCMatch *m, CCCResult *r, int wait);
+CCC_API size_t ccc_match_read_samples(CCCMatch *m, char *buf, size_t size);
@@ -22,15 +22,21 @@
 #endif
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <sys/wait.h>
 
 #include "engine.h"
+#include "memstats.h"
 #include "util.h"
 #include "vec.h"
 
@@ -43,12 +49,25 @@ static void engine_spawn(const Worker *w, Engine *e, const char *cwd, const char
     // 'into' and 'outof' are pipes, each with 2 ends: read=0, write=1
     int outof[2] = {0}, into[2] = {0};
 
+    // Hardware counters: the child waits for the parent to attach them (EOF on 'ready'), so that
+    // they are inherited by all the threads of the engine. A pipe rather than SIGSTOP + waitpid(),
+    // which a library host may defeat by reaping children itself. Read once: the child and the
+    // parent must agree on whether to wait.
+    const bool perf = PerfStats;
+    int ready[2] = {-1, -1};
+
 #ifdef __linux__
     DIE_IF(w->id, pipe2(outof, O_CLOEXEC) < 0);
     DIE_IF(w->id, pipe2(into, O_CLOEXEC) < 0);
+
+    if (perf)
+        DIE_IF(w->id, pipe2(ready, O_CLOEXEC) < 0);
 #else
     DIE_IF(w->id, pipe(outof) < 0);
     DIE_IF(w->id, pipe(into) < 0);
+
+    if (perf)
+        DIE_IF(w->id, pipe(ready) < 0);
 #endif
 
     DIE_IF(w->id, (e->pid = fork()) < 0);
@@ -72,6 +91,14 @@ static void engine_spawn(const Worker *w, Engine *e, const char *cwd, const char
         if (readStdErr)
             DIE_IF(w->id, dup2(outof[1], STDERR_FILENO) < 0);
 
+        if (perf) {
+            char c = 0;
+            DIE_IF(w->id, close(ready[1]) < 0);
+
+            while (read(ready[0], &c, 1) < 0)  // returns 0 (EOF) when the parent is done
+                DIE_IF(w->id, errno != EINTR);
+        }
+
 #ifndef __linux__
         // Ugly (and slow) workaround for non-Linux POSIX systems that lack the ability to
         // atomically set O_CLOEXEC when creating pipes.
@@ -85,6 +112,13 @@ static void engine_spawn(const Worker *w, Engine *e, const char *cwd, const char
         assert(e->pid > 0);
 
         // in the parent process
+        perf_open(e->perf, perf ? e->pid : 0);
+
+        if (perf) {
+            DIE_IF(w->id, close(ready[0]) < 0);
+            DIE_IF(w->id, close(ready[1]) < 0);  // let the child go on
+        }
+
         DIE_IF(w->id, close(into[0]) < 0);
         DIE_IF(w->id, close(outof[1]) < 0);
 
@@ -93,6 +127,68 @@ static void engine_spawn(const Worker *w, Engine *e, const char *cwd, const char
     }
 }
 
+static int engine_socket(const struct addrinfo *ai)
+// Create a TCP socket, with Nagle's algorithm disabled: UCI exchanges short lines, and waiting to
+// coalesce them would only add latency.
+{
+    int type = ai->ai_socktype;
+
+#ifdef __linux__
+    type |= SOCK_CLOEXEC;  // not inherited by engines spawned later (non-Linux: see engine_spawn)
+#endif
+
+    const int fd = socket(ai->ai_family, type, ai->ai_protocol);
+
+    if (fd >= 0) {
+        const int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+
+    return fd;
+}
+
+static void engine_connect(const Worker *w, Engine *e, const char *address)
+// Connect to an engine server (see engine_serve) at address "HOST:PORT"
+{
+    const char *colon = strrchr(address, ':');
+
+    if (!colon)
+        DIE("[%d] invalid engine address '%s', expected tcp://HOST:PORT\n", w->id, address);
+
+    // Strip brackets around IPv6 addresses, eg. "[::1]:5000"
+    scope(str_destroy) str_t host = str_init();
+    const bool brackets = address[0] == '[' && colon > address && colon[-1] == ']';
+    str_ncpy(&host, str_ref(address + brackets), (size_t)(colon - address) - 2 * brackets);
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *ai = NULL;
+    const int err = getaddrinfo(host.buf, colon + 1, &hints, &ai);
+
+    if (err)
+        DIE("[%d] cannot resolve '%s': %s\n", w->id, address, gai_strerror(err));
+
+    // Try each address returned, until one accepts the connection
+    int fd = -1;
+
+    for (const struct addrinfo *p = ai; p && fd < 0; p = p->ai_next)
+        if ((fd = engine_socket(p)) >= 0 && connect(fd, p->ai_addr, p->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+
+    freeaddrinfo(ai);
+
+    if (fd < 0)
+        DIE("[%d] cannot connect to engine server '%s'\n", w->id, address);
+
+    // Separate streams for reading and writing (each fclose() closes its own descriptor)
+    const int fd2 = dup(fd);
+    DIE_IF(w->id, fd2 < 0);
+    DIE_IF(w->id, !(e->in = fdopen(fd, "r")));
+    DIE_IF(w->id, !(e->out = fdopen(fd2, "w")));
+    e->pid = -1;
+    perf_open(e->perf, e->pid);  // no counters: the engine runs on another machine
+}
+
 static void engine_parse_cmd(const char *cmd, str_t *cwd, str_t *run, str_t **args)
 {
     // Isolate the first token being the command to run.
@@ -123,29 +219,38 @@ static void engine_parse_cmd(const char *cmd, str_t *cwd, str_t *run, str_t **ar
 
 Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *options)
 {
+    scope(memstats_leave) int memTag = memstats_enter(MEM_ENGINE);
+
     if (!*cmd)
         DIE("[%d] missing command to start engine.\n", w->id);
 
     Engine e = {0};
     e.name = str_init_from_c(*name ? name : cmd); // default value
-
-    // Parse cmd into (cwd, run, args): we want to execute run from cwd with args.
-    scope(str_destroy) str_t cwd = str_init(), run = str_init();
-    str_t *args = vec_init(str_t);
-    engine_parse_cmd(cmd, &cwd, &run, &args);
-
-    // execvp() needs NULL terminated char **, not vec of str_t. Prepare a char **, whose elements
-    // point to the C-string buffers of the elements of args, with the required NULL at the end.
-    char **argv = calloc(vec_size(args) + 1, sizeof(char *));
-
-    for (size_t i = 0; i < vec_size(args); i++)
-        argv[i] = args[i].buf;
-
-    // Spawn child process and plug pipes
-    engine_spawn(w, &e, cwd.buf, run.buf, argv, w->log != NULL);
-
-    vec_destroy_rec(args, str_destroy);
-    free(argv);
+    const char *address = str_prefix(cmd, "tcp://");
+
+    if (address)
+        // Remote engine: the same UCI dialogue, over a socket
+        engine_connect(w, &e, address);
+    else {
+        // Parse cmd into (cwd, run, args): we want to execute run from cwd with args.
+        scope(str_destroy) str_t cwd = str_init(), run = str_init();
+        str_t *args = vec_init(str_t);
+        engine_parse_cmd(cmd, &cwd, &run, &args);
+
+        // execvp() needs NULL terminated char **, not vec of str_t. Prepare a char **, whose
+        // elements point to the C-string buffers of the elements of args, with the required NULL at
+        // the end.
+        char **argv = calloc(vec_size(args) + 1, sizeof(char *));
+
+        for (size_t i = 0; i < vec_size(args); i++)
+            argv[i] = args[i].buf;
+
+        // Spawn child process and plug pipes
+        engine_spawn(w, &e, cwd.buf, run.buf, argv, w->log != NULL);
+
+        vec_destroy_rec(args, str_destroy);
+        free(argv);
+    }
 
     // Start the uci..uciok dialogue
     deadline_set(w, e.name.buf, system_msec() + 4000);
@@ -176,14 +281,34 @@ Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *op
     return e;
 }
 
+Engine engine_share(const Engine *owner, const char *name)
+// Use the process of 'owner' under another name (the name of 'owner' if empty). The returned Engine
+// must not be used after 'owner' is destroyed (but destroying it only frees the name).
+{
+    scope(memstats_leave) int memTag = memstats_enter(MEM_ENGINE);
+    Engine e = *owner;
+    e.name = str_init_from_c(*name ? name : owner->name.buf);
+    e.shared = true;
+    return e;
+}
+
 void engine_destroy(Worker *w, Engine *e)
 {
+    if (e->shared) {
+        str_destroy(&e->name);
+        return;
+    }
+
     // Order the engine to quit, and grant 1s deadline for obeying
     deadline_set(w, e->name.buf, system_msec() + 1000);
     engine_writeln(w, e, "quit");
-    waitpid(e->pid, NULL, 0);
+
+    if (e->pid > 0)
+        waitpid(e->pid, NULL, 0);
     deadline_clear(w);
 
+    perf_close(e->perf);
+
     str_destroy(&e->name);
     DIE_IF(w->id, fclose(e->in) < 0);
     DIE_IF(w->id, fclose(e->out) < 0);
@@ -212,6 +337,7 @@ void engine_writeln(const Worker *w, const Engine *e, char *buf)
 
 void engine_sync(Worker *w, const Engine *e)
 {
+    scope(memstats_leave) int memTag = memstats_enter(MEM_ENGINE);
     deadline_set(w, e->name.buf, system_msec() + 2000);
     engine_writeln(w, e, "isready");
     scope(str_destroy) str_t line = str_init();
@@ -224,12 +350,20 @@ void engine_sync(Worker *w, const Engine *e)
 }
 
 bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best, str_t *pv,
-    Info *info)
+    Info *info, MultiPV **multiPv)
+// Parse info lines until bestmove. 'pv' and 'info' track the main line (multipv 1). If 'multiPv' is
+// not NULL, the score and PV of every line are also recorded there (indexed by multipv - 1).
 {
+    scope(memstats_leave) int memTag = memstats_enter(MEM_ENGINE);
     int result = false;
-    scope(str_destroy) str_t line = str_init(), token = str_init();
+    scope(str_destroy) str_t line = str_init();
+    strv_t token;  // view of line: info lines are parsed without copies
     str_clear(pv);
 
+    if (multiPv)
+        for (size_t i = 0; i < vec_size(*multiPv); i++)
+            str_clear(&(*multiPv)[i].pv);
+
     const int64_t start = system_msec(), timeLimit = start + *timeLeft;
     deadline_set(w, e->name.buf, timeLimit + 1000);
 
@@ -243,26 +377,59 @@ bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best,
         const char *tail = NULL;
 
         if ((tail = str_prefix(line.buf, "info "))) {
-            while ((tail = str_tok(tail, &token, " "))) {
-                if (!strcmp(token.buf, "depth")) {
-                    if ((tail = str_tok(tail, &token, " ")))
-                        info->depth = atoi(token.buf);
-                } else if (!strcmp(token.buf, "score")) {
-                    if ((tail = str_tok(tail, &token, " "))) {
-                        if (!strcmp(token.buf, "cp") && (tail = str_tok(tail, &token, " ")))
-                            info->score = atoi(token.buf);
-                        else if (!strcmp(token.buf, "mate") && (tail = str_tok(tail, &token, " "))) {
-                            const int movesToMate = atoi(token.buf);
-                            info->score = movesToMate < 0 ? INT_MIN - movesToMate : INT_MAX - movesToMate;
+            const char *pvStart = NULL;
+            int multiPvIdx = 1, score = 0;
+            bool hasScore = false;
+
+            while ((tail = strv_tok(tail, &token, " "))) {
+                if (strv_eq_c(token, "depth")) {
+                    if ((tail = strv_tok(tail, &token, " ")))
+                        info->depth = (int)strv_to_int(token);
+                } else if (strv_eq_c(token, "multipv")) {
+                    if ((tail = strv_tok(tail, &token, " ")))
+                        multiPvIdx = (int)strv_to_int(token);
+                } else if (strv_eq_c(token, "score")) {
+                    if ((tail = strv_tok(tail, &token, " "))) {
+                        hasScore = true;
+
+                        if (strv_eq_c(token, "cp") && (tail = strv_tok(tail, &token, " ")))
+                            score = (int)strv_to_int(token);
+                        else if (strv_eq_c(token, "mate") && (tail = strv_tok(tail, &token, " "))) {
+                            const int movesToMate = (int)strv_to_int(token);
+                            score = movesToMate < 0 ? INT_MIN - movesToMate : INT_MAX - movesToMate;
                         } else
                             DIE("illegal syntax after 'score' in '%s'\n", line.buf);
                     }
-                } else if (!strcmp(token.buf, "pv"))
-                    str_cpy_c(pv, tail + strspn(tail, " "));
+                } else if (strv_eq_c(token, "pv")) {
+                    pvStart = tail + strspn(tail, " ");
+                    break;
+                }
+            }
+
+            // Only the main line determines the move played (and adjudication)
+            if (multiPvIdx == 1) {
+                if (hasScore)
+                    info->score = score;
+
+                if (pvStart)
+                    str_cpy_c(pv, pvStart);
+            }
+
+            if (multiPv && multiPvIdx >= 1) {
+                while (vec_size(*multiPv) < (size_t)multiPvIdx)
+                    vec_push(*multiPv, (MultiPV){.pv = str_init()});
+
+                MultiPV *l = &(*multiPv)[multiPvIdx - 1];
+
+                if (hasScore)
+                    l->score = score;
+
+                if (pvStart)
+                    str_cpy_c(&l->pv, pvStart);
             }
         } else if ((tail = str_prefix(line.buf, "bestmove "))) {
-            str_tok(tail, &token, " ");
-            str_cpy(best, token);
+            strv_tok(tail, &token, " ");
+            str_cpy_v(best, token);
             result = true;
         }
     }
@@ -280,3 +447,67 @@ bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best,
     deadline_clear(w);
     return result;
 }
+
+void engine_serve(const char *cmd, const char *address, int port)
+// Engine server: listen on address:port, and run a new engine process for each connection, with
+// the socket as its stdin and stdout. Runs until killed.
+{
+    scope(str_destroy) str_t service = str_init();
+    str_cpy_fmt(&service, "%i", port);
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_PASSIVE}, *ai = NULL;
+    const int err = getaddrinfo(address, service.buf, &hints, &ai);
+
+    if (err)
+        DIE("cannot resolve '%s': %s\n", address, gai_strerror(err));
+
+    const int fd = engine_socket(ai);
+    const int yes = 1;
+    DIE_IF(0, fd < 0);
+    DIE_IF(0, setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) < 0);
+    DIE_IF(0, bind(fd, ai->ai_addr, ai->ai_addrlen) < 0);
+    DIE_IF(0, listen(fd, SOMAXCONN) < 0);
+    freeaddrinfo(ai);
+
+    signal(SIGCHLD, SIG_IGN);  // engine processes are reaped automatically
+
+    scope(str_destroy) str_t cwd = str_init(), run = str_init();
+    str_t *args = vec_init(str_t);
+    engine_parse_cmd(cmd, &cwd, &run, &args);
+    char **argv = calloc(vec_size(args) + 1, sizeof(char *));
+
+    for (size_t i = 0; i < vec_size(args); i++)
+        argv[i] = args[i].buf;
+
+    printf("Serving '%s' on %s:%d\n", cmd, address, port);
+    fflush(stdout);
+
+    while (true) {
+        const int s = accept(fd, NULL, NULL);
+
+        if (s < 0) {
+            DIE_IF(0, errno != EINTR && errno != ECONNABORTED);
+            continue;
+        }
+
+        // Accepted sockets do not inherit TCP_NODELAY on all systems
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        const pid_t pid = fork();
+        DIE_IF(0, pid < 0);
+
+        if (pid == 0) {
+            // The engine only keeps the connection, as stdin and stdout
+            DIE_IF(0, close(fd) < 0);
+            DIE_IF(0, dup2(s, STDIN_FILENO) < 0);
+            DIE_IF(0, dup2(s, STDOUT_FILENO) < 0);
+            DIE_IF(0, close(s) < 0);
+            DIE_IF(0, chdir(cwd.buf) < 0);
+            DIE_IF(0, execvp(run.buf, argv) < 0);
+        }
+
+        printf("Started engine (pid %d)\n", (int)pid);
+        fflush(stdout);
+        DIE_IF(0, close(s) < 0);
+    }
+}
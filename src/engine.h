@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <sys/types.h>
+#include "perf.h"
 #include "str.h"
 #include "workers.h"
 
@@ -24,9 +25,11 @@
 typedef struct {
     FILE *in, *out;
     str_t name;
-    pid_t pid;
+    pid_t pid;  // -1 for a remote engine (cmd=tcp://HOST:PORT)
+    int perf[NB_PERF];  // hardware counters (-perf), -1 if not available
     bool supportChess960;
-    char pad[3];
+    bool shared;  // borrows the process of another Engine (see engine_share)
+    char pad[6];
 } Engine;
 
 // Elements remembered from parsing info lines (for writing PGN comments)
@@ -35,12 +38,22 @@ typedef struct {
     int64_t time;
 } Info;
 
+// Score and PV of one line, when the engine searches several (option.MultiPV)
+typedef struct {
+    str_t pv;
+    int score;
+    char pad[4];
+} MultiPV;
+
 Engine engine_init(Worker *w, const char *cmd, const char *name, const str_t *options);
+Engine engine_share(const Engine *owner, const char *name);
 void engine_destroy(Worker *w, Engine *e);
 
+void engine_serve(const char *cmd, const char *address, int port);
+
 void engine_readln(const Worker *w, const Engine *e, str_t *line);
 void engine_writeln(const Worker *w, const Engine *e, char *buf);
 
 void engine_sync(Worker *w, const Engine *e);
 bool engine_bestmove(Worker *w, const Engine *e, int64_t *timeLeft, str_t *best, str_t *pv,
-    Info *info);
+    Info *info, MultiPV **multiPv);
@@ -15,6 +15,7 @@
 #include <limits.h>
 #include "game.h"
 #include "gen.h"
+#include "memstats.h"
 #include "util.h"
 #include "vec.h"
 
@@ -105,7 +106,7 @@ static bool illegal_move(move_t move, const move_t *moves)
 
 static Position resolve_pv(const Worker *w, const Game *g, const char *pv)
 {
-    scope(str_destroy) str_t token = str_init();
+    strv_t token;  // view of pv
     const char *tail = pv;
 
     // Start with current position. We can't guarantee that the resolved position won't be in check,
@@ -117,17 +118,17 @@ static Position resolve_pv(const Worker *w, const Game *g, const char *pv)
     int idx = 0;
     move_t *moves = vec_init_reserve(64, move_t);
 
-    while ((tail = str_tok(tail, &token, " "))) {
-        const move_t m = pos_lan_to_move(&p[idx], token.buf);
+    while ((tail = strv_tok(tail, &token, " "))) {
+        const move_t m = pos_lan_to_move(&p[idx], token);
         moves = gen_all_moves(&p[idx], moves);
 
+        // token.buf: rest of the PV, starting with the illegal move
         if (illegal_move(m, moves)) {
-            printf("[%d] WARNING: Illegal move in PV '%s%s' from %s\n", w->id, token.buf, tail,
+            fprintf(w->out, "[%d] WARNING: Illegal move in PV '%s' from %s\n", w->id, token.buf,
                 g->names[g->pos[g->ply].turn].buf);
 
             if (w->log)
-                DIE_IF(w->id, fprintf(w->log, "WARNING: illegal move in PV '%s%s'\n", token.buf,
-                    tail) < 0);
+                DIE_IF(w->id, fprintf(w->log, "WARNING: illegal move in PV '%s'\n", token.buf) < 0);
 
             break;
         }
@@ -155,7 +156,9 @@ Game game_init(int round, int game)
 
     g.pos = vec_init(Position);
     g.info = vec_init(Info);
+    int memTag = memstats_enter(MEM_SAMPLES);
     g.samples = vec_init(Sample);
+    memstats_leave(&memTag);
 
     return g;
 }
@@ -180,17 +183,61 @@ void game_destroy(Game *g)
     str_destroy_n(&g->names[WHITE], &g->names[BLACK]);
 }
 
+static int game_phase(const Position *pos)
+// Phase from the remaining material: N=B=1, R=2, Q=4 (24 in the starting position)
+{
+    const int material = bb_count(pos->byPiece[KNIGHT] | pos->byPiece[BISHOP])
+        + 2 * bb_count(pos->byPiece[ROOK]) + 4 * bb_count(pos->byPiece[QUEEN]);
+
+    return material >= 20 ? PHASE_OPENING : material <= 8 ? PHASE_ENDGAME : PHASE_MIDDLEGAME;
+}
+
+static void select_samples(Worker *w, Game *g, const SamplePolicy *sp)
+// End of game part of the sample policy. Discard samples from the last plies of adjudicated games
+// (decided by the adjudication rule, rather than the engines), then keep at most maxPerGame samples,
+// selected uniformly at random (preserving their order).
+{
+    size_t n = 0;
+
+    for (size_t i = 0; i < vec_size(g->samples); i++)
+        if ((g->state != STATE_RESIGN && g->state != STATE_DRAW_ADJUDICATION)
+                || g->samples[i].ply < g->ply - sp->skipEnd)
+            g->samples[n++] = g->samples[i];
+
+    if (sp->maxPerGame && n > (size_t)sp->maxPerGame) {
+        // Selection sampling: keep each sample with probability needed / remaining
+        size_t needed = (size_t)sp->maxPerGame, kept = 0;
+
+        for (size_t i = 0; i < n && needed; i++)
+            if (prng(&w->seed) % (n - i) < needed) {
+                g->samples[kept++] = g->samples[i];
+                needed--;
+            }
+
+        n = kept;
+    }
+
+    while (vec_size(g->samples) > n)
+        vec_pop(g->samples);
+}
+
+static void multipv_destroy(MultiPV *l)
+{
+    str_destroy(&l->pv);
+}
+
 int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
-    const EngineOptions *eo[2], bool reverse)
+    const EngineOptions *eo[2], bool reverse, Adjudicator *adj)
 // Play a game:
 // - engines[reverse] plays the first move (which does not mean white, that depends on the FEN)
+// - adj: adjudicator pool (NULL if none)
 // - sets g->state value: see enum STATE_* codes
 // - returns RESULT_LOSS/DRAW/WIN from engines[0] pov
 {
     for (int color = WHITE; color <= BLACK; color++)
         str_cpy(&g->names[color], engines[color ^ g->pos[0].turn ^ reverse].name);
 
-    for (int i = 0; i < 2; i++) {
+    for (int i = 0; i < (engines[1].shared ? 1 : 2); i++) {
         if (g->pos[0].chess960) {
             if (engines[i].supportChess960)
                 engine_writeln(w, &engines[i], "setoption name UCI_Chess960 value true");
@@ -206,10 +253,12 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
     move_t played = 0;
     int drawPlyCount = 0;
     int resignCount[NB_COLOR] = {0};
+    int adjDecisive = 0, adjDrawish = 0;  // consecutive adjudicator evaluations (signed: white pov)
     int ei = reverse;  // engines[ei] has the move
     int64_t timeLeft[2] = {eo[0]->time, eo[1]->time};
     scope(str_destroy) str_t pv = str_init();
     move_t *legalMoves = vec_init_reserve(64, move_t);
+    MultiPV *multiPv = o->sampleMultiPv ? vec_init(MultiPV) : NULL;
 
     for (g->ply = 0; ; ei = 1 - ei, g->ply++) {
         if (played)
@@ -219,6 +268,38 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
             break;
 
         uci_position_command(g, &cmd);
+
+        // Adjudicator: collect the last evaluation (if ready), and submit the current position
+        // every N plies. Evaluations are asynchronous, so the players never wait for the
+        // adjudicator.
+        if (adj) {
+            const AdjudicatorParam *ap = adj->ap;
+            int score = 0;
+
+            if (adjudicator_poll(adj, w->id, &score)) {
+                adjDecisive = !ap->resignScore ? 0
+                    : score >= ap->resignScore ? max(adjDecisive, 0) + 1
+                    : score <= -ap->resignScore ? min(adjDecisive, 0) - 1
+                    : 0;
+                adjDrawish = ap->drawScore && abs(score) <= ap->drawScore ? adjDrawish + 1 : 0;
+            }
+
+            if (g->ply % ap->every == 0)
+                adjudicator_submit(adj, w->id, &cmd, g->pos[g->ply].turn, g->pos[0].chess960);
+
+            if (adjDrawish >= ap->count) {
+                g->state = STATE_DRAW_ADJUDICATION;
+                break;
+            }
+
+            // The losing side resigns on its turn
+            if (abs(adjDecisive) >= ap->count
+                    && g->pos[g->ply].turn == (adjDecisive > 0 ? BLACK : WHITE)) {
+                g->state = STATE_RESIGN;
+                break;
+            }
+        }
+
         engine_writeln(w, &engines[ei], cmd.buf);
         engine_sync(w, &engines[ei]);
 
@@ -241,7 +322,8 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
         engine_writeln(w, &engines[ei], cmd.buf);
 
         Info info = {0};
-        const bool ok = engine_bestmove(w, &engines[ei], &timeLeft[ei], &best, &pv, &info);
+        const bool ok = engine_bestmove(w, &engines[ei], &timeLeft[ei], &best, &pv, &info,
+            multiPv ? &multiPv : NULL);
         vec_push(g->info, info);
 
         // Parses the last PV sent. An invalid PV is not fatal, but logs some warnings. Keep track
@@ -254,7 +336,7 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
             break;
         }
 
-        played = pos_lan_to_move(&g->pos[g->ply], best.buf);
+        played = pos_lan_to_move(&g->pos[g->ply], str_view(best));
 
         if (illegal_move(played, legalMoves)) {
             g->state = STATE_ILLEGAL_MOVE;
@@ -285,24 +367,47 @@ int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
             resignCount[ei] = 0;
 
         // Write sample: position (compactly encoded) + score
-        if (prngf(&w->seed) <= o->sampleFrequency) {
+        const SamplePolicy *sp = &o->samplePolicy;
+
+        if (prngf(&w->seed) <= sp->rate[game_phase(&g->pos[g->ply])]
+                && g->ply >= sp->minPly && g->ply <= sp->maxPly) {
             Sample sample = {
                 .pos = o->sampleResolvePv ? resolved : g->pos[g->ply],
                 .score = info.score,
-                .result = NB_RESULT // unknown yet (use invalid state for now)
+                .result = NB_RESULT, // unknown yet (use invalid state for now)
+                .ply = g->ply
             };
 
             // Record sample, except if resolvePv=true and the position is in check (becuase PV
             // resolution couldn't avoid it), in which case the sample is discarded.
-            if (!o->sampleResolvePv || !sample.pos.checkers)
+            if ((!o->sampleResolvePv || !sample.pos.checkers) && abs(sample.score) <= sp->maxScore)
                 vec_push(g->samples, sample);
+
+            // Other MultiPV lines: record the resolved position of each PV, with its score. Skip
+            // those that could not be resolved away from the current position, or not out of check.
+            for (size_t i = 1; i < vec_size(multiPv); i++) {
+                if (!multiPv[i].pv.len || abs(multiPv[i].score) > sp->maxScore)
+                    continue;
+
+                const Position leaf = resolve_pv(w, g, multiPv[i].pv.buf);
+
+                if (leaf.key != g->pos[g->ply].key && !leaf.checkers)
+                    vec_push(g->samples, ((Sample){.pos = leaf, .score = multiPv[i].score,
+                        .result = NB_RESULT, .ply = g->ply}));
+            }
         }
 
         vec_push(g->pos, (Position){0});
     }
 
     assert(g->state != STATE_NONE);
+    vec_destroy_rec(multiPv, multipv_destroy);
+
+    if (adj)
+        adjudicator_cancel(adj, w->id);
+
     vec_destroy(legalMoves);
+    select_samples(w, g, &o->samplePolicy);
 
     // Signed result from white's pov: -1 (loss), 0 (draw), +1 (win)
     const int wpov = g->state < STATE_SEPARATOR
@@ -438,3 +543,23 @@ void game_export_samples(const Game *g, str_t *out)
         str_cat_fmt(out, "%S,%i,%i\n", fen, g->samples[i].score, g->samples[i].result);
     }
 }
+
+void game_export_record(const Game *g, GameRecord *r, str_t *fen, move_t **moves)
+// Fill the parts of a game database record that come from the game itself, as well as the starting
+// FEN and the list of moves played
+{
+    r->round = g->round;
+    r->game = g->game;
+    r->ply = (uint16_t)g->ply;
+    r->state = (uint8_t)g->state;
+
+    // Losing states are from the pov of the side to move at the end of the game
+    r->result = g->state > STATE_SEPARATOR ? RESULT_DRAW
+        : g->pos[g->ply].turn == WHITE ? RESULT_LOSS : RESULT_WIN;
+
+    pos_get(&g->pos[0], fen, g->sfen);
+    vec_clear(*moves);
+
+    for (int ply = 1; ply <= g->ply; ply++)
+        vec_push(*moves, g->pos[ply].lastMove);
+}
@@ -15,6 +15,7 @@
 #pragma once
 #include "position.h"
 #include "engine.h"
+#include "gamedb.h"
 #include "options.h"
 #include "str.h"
 
@@ -41,6 +42,8 @@ typedef struct {
     Position pos;
     int score;  // score returned by the engine (in cp)
     int result;  // game result from pos.turn's pov
+    int ply;  // game ply where the sample was taken
+    char pad[4];
 } Sample;
 
 typedef struct {
@@ -59,8 +62,9 @@ void game_destroy(Game *g);
 bool game_load_fen(Game *g, const char *fen, int *color);
 
 int game_play(Worker *w, Game *g, const Options *o, const Engine engines[2],
-    const EngineOptions *eo[2], bool reverse);
+    const EngineOptions *eo[2], bool reverse, Adjudicator *adj);
 
 void game_decode_state(const Game *g, str_t *result, str_t *reason);
 void game_export_pgn(const Game *g, int verbosity, str_t *out);
 void game_export_samples(const Game *g, str_t *out);
+void game_export_record(const Game *g, GameRecord *r, str_t *fen, move_t **moves);
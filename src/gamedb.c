@@ -0,0 +1,242 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <assert.h>
+#include <string.h>
+#include "game.h"
+#include "gamedb.h"
+#include "util.h"
+#include "vec.h"
+
+static const char GameDBMagic[8] = "CCCGDB01";  // start of the records file
+
+static FILE *gamedb_open(const str_t *fileName, const char *suffix, const char *mode)
+{
+    scope(str_destroy) str_t name = str_init_from(*fileName);
+    str_cat_c(&name, suffix);
+    return fopen(name.buf, mode);
+}
+
+GameDB gamedb_init(const char *fileName)
+{
+    GameDB db = {0};
+    db.fileName = str_init_from_c(fileName);
+    pthread_mutex_init(&db.mtx, NULL);
+
+    DIE_IF(0, !(db.records = gamedb_open(&db.fileName, "", "we")));
+    DIE_IF(0, !(db.moves = gamedb_open(&db.fileName, ".moves", "we")));
+    DIE_IF(0, !(db.index = gamedb_open(&db.fileName, ".idx", "we")));
+
+    DIE_IF(0, fwrite(GameDBMagic, sizeof(GameDBMagic), 1, db.records) != 1);
+    db.recordsSize = sizeof(GameDBMagic);
+
+    return db;
+}
+
+void gamedb_destroy(GameDB *db, const str_t *names)
+{
+    FILE *out = gamedb_open(&db->fileName, ".names", "we");
+    DIE_IF(0, !out);
+
+    for (size_t i = 0; i < vec_size(names); i++)
+        DIE_IF(0, fprintf(out, "%s\n", names[i].buf) < 0);
+
+    DIE_IF(0, fclose(out) < 0);
+    DIE_IF(0, fclose(db->index) < 0);
+    DIE_IF(0, fclose(db->moves) < 0);
+    DIE_IF(0, fclose(db->records) < 0);
+
+    str_destroy(&db->fileName);
+    pthread_mutex_destroy(&db->mtx);
+}
+
+void gamedb_push(GameDB *db, GameRecord *r, const str_t *fen, const move_t *moves)
+// Append a game to the database. Games can be pushed in any order: the index is written at position
+// r->idx, leaving zeroes for games that are not completed yet.
+{
+    assert(vec_size(moves) == r->ply);
+    pthread_mutex_lock(&db->mtx);
+
+    // Move stream: FEN (including the terminating '\0'), followed by the moves
+    r->offset = db->movesSize;
+    DIE_IF(0, fwrite(fen->buf, fen->len + 1, 1, db->moves) != 1);
+    DIE_IF(0, r->ply && fwrite(moves, sizeof(move_t), r->ply, db->moves) != r->ply);
+    db->movesSize += fen->len + 1 + r->ply * sizeof(move_t);
+
+    const uint64_t offset = db->recordsSize;
+    DIE_IF(0, fwrite(r, sizeof(*r), 1, db->records) != 1);
+    db->recordsSize += sizeof(*r);
+
+    DIE_IF(0, fseek(db->index, (long)(r->idx * sizeof(offset)), SEEK_SET) < 0);
+    DIE_IF(0, fwrite(&offset, sizeof(offset), 1, db->index) != 1);
+
+    pthread_mutex_unlock(&db->mtx);
+}
+
+GameDBQuery gamedb_query_init(void)
+{
+    GameDBQuery q = {0};
+    q.file = str_init();
+    q.engine = str_init();
+    q.result = str_init();
+    q.reason = str_init();
+    q.pgn = str_init();
+    q.idx = q.opening = -1;
+    return q;
+}
+
+void gamedb_query_destroy(GameDBQuery *q)
+{
+    str_destroy_n(&q->file, &q->engine, &q->result, &q->reason, &q->pgn);
+}
+
+static bool gamedb_read_record(FILE *records, uint64_t offset, GameRecord *r)
+{
+    return fseek(records, (long)offset, SEEK_SET) >= 0 && fread(r, sizeof(*r), 1, records) == 1;
+}
+
+static void gamedb_load_game(FILE *moves, const GameRecord *r, const str_t *names, Game *g)
+// Rebuild a Game from its record and move stream (enough to export it to PGN, without comments)
+{
+    DIE_IF(0, fseek(moves, (long)r->offset, SEEK_SET) < 0);
+
+    scope(str_destroy) str_t fen = str_init();
+    int c;
+
+    while ((c = fgetc(moves)) > 0)
+        str_push(&fen, (char)c);
+
+    int turn = WHITE;
+
+    if (c < 0 || !game_load_fen(g, fen.buf, &turn))
+        DIE("Corrupted game database: cannot read FEN of game %" PRIu64 "\n", r->idx + 1);
+
+    for (int ply = 1; ply <= r->ply; ply++) {
+        move_t m = 0;
+        DIE_IF(0, fread(&m, sizeof(m), 1, moves) != 1);
+
+        Position next;
+        pos_move(&next, &g->pos[ply - 1], m);
+        vec_push(g->pos, next);
+        vec_push(g->info, (Info){0});
+    }
+
+    for (int color = WHITE; color <= BLACK; color++)
+        if ((size_t)r->ei[color] < vec_size(names))
+            str_cpy(&g->names[color], names[r->ei[color]]);
+
+    g->ply = r->ply;
+    g->state = r->state;
+}
+
+static bool gamedb_match(const GameDBQuery *q, const GameRecord *r, const str_t *names)
+// Filter on the record alone, before reading the move stream
+{
+    static const char *results[NB_RESULT] = {"0-1", "1/2-1/2", "1-0"};
+
+    if ((q->opening >= 0 && (uint64_t)q->opening != r->opening)
+            || (q->result.len && (r->result >= NB_RESULT || strcmp(q->result.buf, results[r->result]))))
+        return false;
+
+    if (q->engine.len) {
+        for (int color = WHITE; color <= BLACK; color++)
+            if ((size_t)r->ei[color] < vec_size(names) && str_eq(q->engine, names[r->ei[color]]))
+                return true;
+
+        return false;
+    }
+
+    return true;
+}
+
+void gamedb_query(const GameDBQuery *q)
+// Select games from q->file: lookup by idx uses the index, otherwise scan all the records (in order
+// of completion). Matching games are summarized on stdout, and exported to q->pgn (if any).
+{
+    FILE *records = NULL, *moves = NULL, *index = NULL, *pgn = NULL;
+    DIE_IF(0, !(records = gamedb_open(&q->file, "", "re")));
+    DIE_IF(0, !(moves = gamedb_open(&q->file, ".moves", "re")));
+    DIE_IF(0, !(index = gamedb_open(&q->file, ".idx", "re")));
+
+    if (q->pgn.len)
+        DIE_IF(0, !(pgn = fopen(q->pgn.buf, "we")));
+
+    char magic[sizeof(GameDBMagic)] = "";
+
+    if (fread(magic, sizeof(magic), 1, records) != 1 || memcmp(magic, GameDBMagic, sizeof(magic)))
+        DIE("'%s' is not a game database\n", q->file.buf);
+
+    // Engine names, by index
+    str_t *names = vec_init(str_t);
+    FILE *in = gamedb_open(&q->file, ".names", "re");
+
+    if (in) {
+        scope(str_destroy) str_t line = str_init();
+
+        while (str_getline(&line, in))
+            vec_push(names, str_init_from(line));
+
+        DIE_IF(0, fclose(in) < 0);
+    }
+
+    scope(str_destroy) str_t result = str_init(), reason = str_init(), out = str_init();
+    uint64_t offset = sizeof(GameDBMagic);
+    size_t matches = 0;
+    GameRecord r;
+
+    if (q->idx >= 0) {
+        // Lookup in the index (a missing entry reads as 0)
+        if (fseek(index, (long)((uint64_t)q->idx * sizeof(offset)), SEEK_SET) < 0
+                || fread(&offset, sizeof(offset), 1, index) != 1)
+            offset = 0;
+    }
+
+    // By idx: only one record. Otherwise: scan the whole file.
+    for (; offset && gamedb_read_record(records, offset, &r);
+            offset = q->idx >= 0 ? 0 : offset + sizeof(r)) {
+        if (q->idx >= 0 && r.idx != (uint64_t)q->idx)
+            DIE("Corrupted game database: wrong index for game %" PRIi64 "\n", q->idx + 1);
+
+        if (!gamedb_match(q, &r, names))
+            continue;
+
+        Game g = game_init(r.round, r.game);
+        gamedb_load_game(moves, &r, names, &g);
+        game_decode_state(&g, &result, &reason);
+
+        if (!q->reason.len || str_eq(q->reason, reason)) {
+            matches++;
+            printf("%" PRIu64 ": %s vs %s, %s {%s}, %d plies, opening %" PRIu64 "\n", r.idx + 1,
+                g.names[WHITE].buf, g.names[BLACK].buf, result.buf, reason.buf, r.ply,
+                r.opening + 1);
+
+            if (pgn) {
+                game_export_pgn(&g, 1, &out);
+                DIE_IF(0, fputs(out.buf, pgn) < 0);
+            }
+        }
+
+        game_destroy(&g);
+    }
+
+    printf("%zu games found\n", matches);
+
+    if (pgn)
+        DIE_IF(0, fclose(pgn) < 0);
+
+    vec_destroy_rec(names, str_destroy);
+    DIE_IF(0, fclose(index) < 0);
+    DIE_IF(0, fclose(moves) < 0);
+    DIE_IF(0, fclose(records) < 0);
+}
@@ -0,0 +1,57 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "bitboard.h"
+#include "str.h"
+
+// Fixed size header of each game in the database (native byte order)
+typedef struct {
+    uint64_t idx;  // game number (starts at 0, in job order)
+    uint64_t opening;  // line number of the opening in the book
+    uint64_t offset;  // offset of the game in the move stream (FEN, then ply moves)
+    int32_t round, game;
+    int16_t ei[NB_COLOR];  // engine index, by color
+    uint16_t ply;  // number of plies played
+    uint8_t result;  // RESULT_xxx from white's pov
+    uint8_t state;  // STATE_xxx
+} GameRecord;
+
+// Game database: records are appended to 'fileName' in order of completion, and the move stream to
+// 'fileName.moves'. 'fileName.idx' maps idx to the offset of its record (0 if missing). Engine
+// names are written to 'fileName.names' (one per line, by engine index) on exit.
+typedef struct {
+    pthread_mutex_t mtx;
+    FILE *records, *moves, *index;
+    str_t fileName;
+    uint64_t recordsSize, movesSize;
+} GameDB;
+
+// Query: select games from a database, print a summary line for each, and export them to PGN
+typedef struct {
+    str_t file, engine, result, reason, pgn;
+    int64_t idx, opening;  // -1 if any
+} GameDBQuery;
+
+GameDB gamedb_init(const char *fileName);
+void gamedb_destroy(GameDB *db, const str_t *names);
+
+void gamedb_push(GameDB *db, GameRecord *r, const str_t *fen, const move_t *moves);
+
+GameDBQuery gamedb_query_init(void);
+void gamedb_query_destroy(GameDBQuery *q);
+void gamedb_query(const GameDBQuery *q);
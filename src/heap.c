@@ -0,0 +1,64 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "heap.h"
+
+static void heap_swap(char *a, char *b, size_t esize)
+{
+    for (size_t i = 0; i < esize; i++) {
+        const char tmp = a[i];
+        a[i] = b[i];
+        b[i] = tmp;
+    }
+}
+
+void heap_do_sift_up(void *v, size_t esize, size_t i, int (*cmp)(const void *, const void *))
+// Move v[i] up, until its parent is not greater
+{
+    char *buf = v;
+
+    while (i > 0) {
+        const size_t parent = (i - 1) / 2;
+
+        if (cmp(&buf[parent * esize], &buf[i * esize]) <= 0)
+            break;
+
+        heap_swap(&buf[parent * esize], &buf[i * esize], esize);
+        i = parent;
+    }
+}
+
+void heap_do_pop(void *v, size_t esize, int (*cmp)(const void *, const void *))
+// Replace v[0] with the last element, and move it down, until none of its children is smaller
+{
+    const size_t n = vec_size(v) - 1;
+    char *buf = v;
+    memcpy(buf, &buf[n * esize], esize);
+    vec_ptr(v)->size = n;
+
+    for (size_t i = 0; ; ) {
+        size_t smallest = i;
+
+        for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < n; child++)
+            if (cmp(&buf[child * esize], &buf[smallest * esize]) < 0)
+                smallest = child;
+
+        if (smallest == i)
+            break;
+
+        heap_swap(&buf[smallest * esize], &buf[i * esize], esize);
+        i = smallest;
+    }
+}
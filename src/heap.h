@@ -0,0 +1,35 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <stddef.h>
+#include "vec.h"
+
+// Binary heap stored in a vec: v[0] is the smallest element, according to cmp() (same convention as
+// qsort). Push and pop are O(log n), instead of keeping the vec sorted with memmove().
+
+void heap_do_sift_up(void *v, size_t esize, size_t i, int (*cmp)(const void *, const void *));
+void heap_do_pop(void *v, size_t esize, int (*cmp)(const void *, const void *));
+
+#define heap_push(v, e, cmp) ({ \
+    vec_push(v, e); \
+    heap_do_sift_up(v, sizeof(*(v)), vec_size(v) - 1, cmp); \
+})
+
+// remove and return the smallest element
+#define heap_pop(v, cmp) ({ \
+    const typeof(*(v)) _top = (v)[0]; \
+    heap_do_pop(v, sizeof(*(v)), cmp); \
+    _top; \
+})
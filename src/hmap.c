@@ -0,0 +1,148 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "hmap.h"
+
+static size_t hmap_slot(const hmap_t *p, uint64_t key)
+// Home slot of key: mix the bits first (keys can be indexes, not only random hashes)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (size_t)key & (p->capacity - 1);
+}
+
+static uint64_t hmap_key(const hmap_t *p, size_t esize, size_t i)
+{
+    uint64_t key;
+    memcpy(&key, &p->buf[i * esize], sizeof(key));
+    return key;
+}
+
+static hmap_t *hmap_alloc(size_t capacity, size_t esize)
+{
+    assert(capacity && !(capacity & (capacity - 1)) && esize >= sizeof(uint64_t));
+    hmap_t *p = malloc(sizeof(hmap_t) + capacity * (esize + sizeof(bool)));
+    p->capacity = capacity;
+    p->size = 0;
+    p->used = (bool *)&p->buf[capacity * esize];
+    memset(p->used, 0, capacity * sizeof(bool));
+    return p;
+}
+
+hmap_t *hmap_ptr(void *h)
+{
+    assert(h);
+    return (hmap_t *)((char *)(h) - offsetof(hmap_t, buf));
+}
+
+const hmap_t *hmap_cptr(const void *h)
+{
+    return (const hmap_t *)((const char *)(h) - offsetof(hmap_t, buf));
+}
+
+void *hmap_do_init(size_t esize)
+{
+    return hmap_alloc(16, esize)->buf;
+}
+
+size_t hmap_size(const void *h)
+{
+    return h ? hmap_cptr(h)->size : 0;
+}
+
+static size_t hmap_probe(const hmap_t *p, size_t esize, uint64_t key)
+// Slot of key, or the first free slot where it would be inserted
+{
+    size_t i = hmap_slot(p, key);
+
+    while (p->used[i] && hmap_key(p, esize, i) != key)
+        i = (i + 1) & (p->capacity - 1);
+
+    return i;
+}
+
+void *hmap_do_find(void *h, size_t esize, uint64_t key)
+{
+    hmap_t *p = hmap_ptr(h);
+    const size_t i = hmap_probe(p, esize, key);
+    return p->used[i] ? &p->buf[i * esize] : NULL;
+}
+
+void *hmap_do_grow(void *h, size_t esize)
+// Make room for one more element: double the capacity (and rehash) if the table is half full
+{
+    hmap_t *p = hmap_ptr(h);
+
+    if (2 * (p->size + 1) <= p->capacity)
+        return h;
+
+    hmap_t *q = hmap_alloc(2 * p->capacity, esize);
+
+    for (size_t i = 0; i < p->capacity; i++)
+        if (p->used[i]) {
+            const size_t j = hmap_probe(q, esize, hmap_key(p, esize, i));
+            memcpy(&q->buf[j * esize], &p->buf[i * esize], esize);
+            q->used[j] = true;
+        }
+
+    q->size = p->size;
+    free(p);
+    return q->buf;
+}
+
+void *hmap_do_insert(void *h, size_t esize, uint64_t key)
+// The table must have room for one more element (see hmap_do_grow)
+{
+    hmap_t *p = hmap_ptr(h);
+    const size_t i = hmap_probe(p, esize, key);
+    char *e = &p->buf[i * esize];
+
+    if (!p->used[i]) {
+        assert(p->size + 1 < p->capacity);
+        memset(e, 0, esize);
+        memcpy(e, &key, sizeof(key));
+        p->used[i] = true;
+        p->size++;
+    }
+
+    return e;
+}
+
+bool hmap_do_erase(void *h, size_t esize, uint64_t key)
+// Backward shift deletion: move the following elements of the cluster into the hole, when their home
+// slot allows it, so that lookups never need tombstones.
+{
+    hmap_t *p = hmap_ptr(h);
+    const size_t mask = p->capacity - 1;
+    size_t hole = hmap_probe(p, esize, key);
+
+    if (!p->used[hole])
+        return false;
+
+    for (size_t i = (hole + 1) & mask; p->used[i]; i = (i + 1) & mask) {
+        // Move buf[i] into the hole, if its home slot is not in (hole, i] (cyclically)
+        const size_t home = hmap_slot(p, hmap_key(p, esize, i));
+
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            memcpy(&p->buf[hole * esize], &p->buf[i * esize], esize);
+            hole = i;
+        }
+    }
+
+    p->used[hole] = false;
+    p->size--;
+    return true;
+}
@@ -0,0 +1,60 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Hash map: open addressing (linear probing) table of elements whose first member is their key
+// (uint64_t). Lookup, insertion and removal are O(1) on average, instead of scanning a vec. The table
+// grows to keep its load factor at most 1/2, and element pointers are invalidated when it does.
+typedef struct {
+    size_t capacity;  // power of 2
+    size_t size;
+    bool *used;  // used[i]: is buf[i] an element (stored after the elements)
+    char buf[];
+} hmap_t;
+
+hmap_t *hmap_ptr(void *h);
+const hmap_t *hmap_cptr(const void *h);
+
+void *hmap_do_init(size_t esize);
+#define hmap_init(etype) hmap_do_init(sizeof(etype))
+
+#define hmap_destroy(h) ({ \
+    if (h) free(hmap_ptr(h)); \
+    h = NULL; \
+})
+
+size_t hmap_size(const void *h);
+
+void *hmap_do_find(void *h, size_t esize, uint64_t key);
+void *hmap_do_grow(void *h, size_t esize);
+void *hmap_do_insert(void *h, size_t esize, uint64_t key);
+bool hmap_do_erase(void *h, size_t esize, uint64_t key);
+
+// element of 'key', or NULL if not found
+#define hmap_find(h, key) ((typeof(h))hmap_do_find(h, sizeof(*(h)), key))
+
+// element of 'key': existing one, or new one (zero initialized, except for its key)
+#define hmap_insert(h, key) ({ \
+    h = hmap_do_grow(h, sizeof(*(h))); \
+    (typeof(h))hmap_do_insert(h, sizeof(*(h)), key); \
+})
+
+// remove the element of 'key', returns false if not found
+#define hmap_erase(h, key) hmap_do_erase(h, sizeof(*(h)), key)
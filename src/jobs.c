@@ -13,90 +13,464 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #include "jobs.h"
+#include "util.h"
 #include "vec.h"
 #include "workers.h"
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-static void job_queue_init_pair(int games, int e1, int e2, int pair, int *added, int round,
-    Job **jobs)
+static size_t job_queue_generated(const JobQueue *jq)
+// Number of jobs generated so far (Swiss/race: up to the end of the current round)
 {
-    for (int g = 0; g < games; g++) {
-        const Job j = {
-            .ei = {e1, e2},
-            .pair = pair,
-            .round = round, .game = (*added)++,
-            .reverse = g % 2
-        };
-        vec_push(*jobs, j);
+    return jq->tournament == TOURNAMENT_SWISS || jq->tournament == TOURNAMENT_RACE
+        ? jq->first + vec_size(jq->pairs) * (size_t)jq->games
+        : jq->count;
+}
+
+static void job_queue_next_round(JobQueue *jq)
+// Swiss/race: start a new round, whose pairs are pushed by the caller
+{
+    jq->first = job_queue_generated(jq);
+    vec_clear(jq->pairs);
+    jq->round++;
+}
+
+static Job job_queue_job(const JobQueue *jq, size_t idx)
+// Compute the job of index idx. Each round plays pairs[] in order, each for jq->games games.
+{
+    const size_t perRound = vec_size(jq->pairs) * (size_t)jq->games;
+    size_t round, game;
+
+    if (jq->tournament == TOURNAMENT_SWISS || jq->tournament == TOURNAMENT_RACE) {
+        // only the current round is known
+        assert(jq->first <= idx && idx < jq->first + perRound);
+        round = (size_t)jq->round - 1;
+        game = idx - jq->first;
+    } else {
+        round = idx / perRound;
+        game = idx % perRound;
+    }
+
+    const int pair = jq->pairs[game / (size_t)jq->games], g = (int)(game % (size_t)jq->games);
+
+    return (Job){
+        .ei = {jq->results[pair].ei[0], jq->results[pair].ei[1]},
+        .pair = pair,
+        .round = (int)round, .game = (int)game,
+        .reverse = jq->tournament == TOURNAMENT_SWISS ? (g + (int)round) % 2 : g % 2
+    };
+}
+
+static int job_queue_pair(int engines, int e1, int e2)
+// Index of pair (e1, e2) in round robin order, with e1 < e2
+{
+    assert(0 <= e1 && e1 < e2 && e2 < engines);
+    return e1 * (2 * engines - e1 - 1) / 2 + (e2 - e1 - 1);
+}
+
+static int *job_queue_standings(const JobQueue *jq, int **points)
+// Returns a vector of engines sorted by decreasing points (ties broken by engine index). Points are
+// counted in half points, and byes count as a win.
+{
+    *points = vec_init_reserve((size_t)jq->engines, int);
+
+    for (int e = 0; e < jq->engines; e++)
+        vec_push(*points, 2 * jq->byes[e]);
+
+    for (size_t i = 0; i < vec_size(jq->results); i++) {
+        const Result *r = &jq->results[i];
+        (*points)[r->ei[0]] += 2 * r->count[RESULT_WIN] + r->count[RESULT_DRAW];
+        (*points)[r->ei[1]] += 2 * r->count[RESULT_LOSS] + r->count[RESULT_DRAW];
+    }
+
+    int *standings = vec_init_reserve((size_t)jq->engines, int);
+
+    for (int e = 0; e < jq->engines; e++) {
+        // insertion sort
+        int i = (int)vec_size(standings);
+        vec_push(standings, e);
+
+        for (; i > 0 && (*points)[standings[i - 1]] < (*points)[e]; i--)
+            standings[i] = standings[i - 1];
+
+        standings[i] = e;
+    }
+
+    return standings;
+}
+
+static void job_queue_print_standings(const JobQueue *jq)
+{
+    scope(str_destroy) str_t out = str_init();
+    str_cpy_fmt(&out, "Standings after round %i:\n", jq->round);
+    int *points = NULL;
+    int *standings = job_queue_standings(jq, &points);
+
+    for (size_t i = 0; i < vec_size(standings); i++) {
+        const int e = standings[i];
+        str_cat_fmt(&out, "%u. %S: %i%s\n", (unsigned)i + 1, jq->names[e], points[e] / 2,
+            points[e] % 2 ? ".5" : "");
+    }
+
+    fputs(out.buf, jq->out);
+    vec_destroy(standings);
+    vec_destroy(points);
+}
+
+static void job_queue_swiss_round(JobQueue *jq)
+// Pair engines for the next Swiss round, according to current standings. Each engine is paired with
+// the highest ranked engine below it, that it has not yet played (if possible). If the number of
+// engines is odd, the lowest ranked engine that has not yet received a bye gets one.
+{
+    if (jq->round)
+        job_queue_print_standings(jq);
+
+    int *points = NULL;
+    int *standings = job_queue_standings(jq, &points);
+    const size_t n = vec_size(standings);
+    bool *paired = calloc(n, sizeof(bool));
+
+    if (n % 2) {
+        size_t bye = n - 1;
+        int fewest = jq->byes[standings[bye]];
+
+        for (size_t i = n; i-- > 0; )
+            if (jq->byes[standings[i]] < fewest) {
+                fewest = jq->byes[standings[i]];
+                bye = i;
+            }
+
+        paired[bye] = true;
+        jq->byes[standings[bye]]++;
+    }
+
+    job_queue_next_round(jq);
+
+    for (size_t i = 0; i < n; i++) {
+        if (paired[i])
+            continue;
+
+        // Find the best opponent below i: first one not played yet, otherwise the first one
+        size_t opponent = n;
+
+        for (size_t j = i + 1; j < n; j++)
+            if (!paired[j]) {
+                const int e1 = min(standings[i], standings[j]), e2 = max(standings[i], standings[j]);
+                const Result *r = &jq->results[job_queue_pair(jq->engines, e1, e2)];
+
+                if (opponent == n)
+                    opponent = j;
+
+                if (!(r->count[RESULT_WIN] + r->count[RESULT_LOSS] + r->count[RESULT_DRAW])) {
+                    opponent = j;
+                    break;
+                }
+            }
+
+        assert(opponent < n);
+        paired[i] = paired[opponent] = true;
+
+        const int e1 = min(standings[i], standings[opponent]);
+        const int e2 = max(standings[i], standings[opponent]);
+        vec_push(jq->pairs, job_queue_pair(jq->engines, e1, e2));
+    }
+
+    free(paired);
+    vec_destroy(standings);
+    vec_destroy(points);
+}
+
+static void job_queue_race_pairs(JobQueue *jq)
+// Start the next race stage: surviving candidates play each other (or the reference)
+{
+    job_queue_next_round(jq);
+    int pair = 0;  // enumerate pairs in order
+
+    for (int e1 = 0; e1 < jq->engines - 1; e1++)
+        for (int e2 = e1 + 1; e2 < jq->engines; e2++, pair++)
+            if (!jq->eliminated[e1] && !jq->eliminated[e2] && (!jq->race.reference || !e1))
+                vec_push(jq->pairs, pair);
+}
+
+static void job_queue_race_stage(JobQueue *jq)
+// Called when all jobs of the current stage are completed. Rank the surviving candidates by score,
+// and eliminate the bottom half, except those that are within z standard errors of the last
+// survivor. Then start the next stage, unless the race is over.
+{
+    int (*count)[3] = calloc((size_t)jq->engines, sizeof(*count));  // W, D, L from each engine's pov
+
+    for (size_t i = 0; i < vec_size(jq->results); i++) {
+        const Result *r = &jq->results[i];
+        count[r->ei[0]][0] += r->count[RESULT_WIN];
+        count[r->ei[0]][1] += r->count[RESULT_DRAW];
+        count[r->ei[0]][2] += r->count[RESULT_LOSS];
+        count[r->ei[1]][0] += r->count[RESULT_LOSS];
+        count[r->ei[1]][1] += r->count[RESULT_DRAW];
+        count[r->ei[1]][2] += r->count[RESULT_WIN];
+    }
+
+    double *score = calloc((size_t)jq->engines, sizeof(double));
+    double *error = calloc((size_t)jq->engines, sizeof(double));  // standard error of score
+    int *ranking = vec_init_reserve((size_t)jq->engines, int);
+
+    for (int e = jq->race.reference ? 1 : 0; e < jq->engines; e++) {
+        if (jq->eliminated[e])
+            continue;
+
+        const double n = count[e][0] + count[e][1] + count[e][2];
+        score[e] = (count[e][0] + 0.5 * count[e][1]) / n;
+        const double variance = (count[e][0] + 0.25 * count[e][1]) / n - score[e] * score[e];
+        error[e] = sqrt(variance / n);
+
+        // insertion sort
+        int i = (int)vec_size(ranking);
+        vec_push(ranking, e);
+
+        for (; i > 0 && score[ranking[i - 1]] < score[e]; i--)
+            ranking[i] = ranking[i - 1];
+
+        ranking[i] = e;
+    }
+
+    const size_t candidates = vec_size(ranking), keep = (candidates + 1) / 2;
+    const int last = ranking[keep - 1];
+    size_t survivors = candidates;
+    scope(str_destroy) str_t out = str_init();
+    str_cpy_fmt(&out, "Race after stage %i:\n", jq->round);
+
+    for (size_t i = 0; i < candidates; i++) {
+        const int e = ranking[i];
+        const double gap = score[last] - score[e];
+
+        if (i >= keep && gap > jq->race.z * sqrt(error[e] * error[e] + error[last] * error[last])) {
+            jq->eliminated[e] = true;
+            survivors--;
+        }
+
+        char buf[32] = "";
+        sprintf(buf, "[%.3f +/- %.3f]", score[e], error[e]);
+        str_cat_fmt(&out, "%u. %S: %s %i%s\n", (unsigned)i + 1, jq->names[e], buf,
+            count[e][0] + count[e][1] + count[e][2], jq->eliminated[e] ? " (eliminated)" : "");
     }
+
+    if (survivors == 1 || jq->round == jq->rounds) {
+        str_cat_fmt(&out, "Race winner: %S\n", jq->names[ranking[0]]);
+        jq->count = job_queue_generated(jq);
+    } else
+        job_queue_race_pairs(jq);
+
+    fputs(out.buf, jq->out);
+    vec_destroy(ranking);
+    free(error);
+    free(score);
+    free(count);
 }
 
-JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet)
+JobQueue job_queue_init(int engines, int rounds, int games, int tournament, const RaceParam *rp)
 {
     assert(engines >= 2 && rounds >= 1 && games >= 1);
 
     JobQueue jq = {0};
     pthread_mutex_init(&jq.mtx, NULL);
+    pthread_cond_init(&jq.cond, NULL);
 
-    jq.jobs = vec_init(Job);
+    jq.pairs = vec_init(int);
     jq.results = vec_init(Result);
+    jq.pending = vec_init(PendingPair);
+    jq.groups = vec_init(JobGroup);
     jq.names = vec_init(str_t);
+    jq.byes = vec_init(int);
+    jq.eliminated = vec_init(bool);
+    jq.out = stdout;
+    jq.race = *rp;
+
+    jq.tournament = tournament;
+    jq.engines = engines;
+    jq.rounds = rounds;
+    jq.games = games;
 
-    // Prepare engine names: blank for now, will be discovered at run time (concurrently)
-    for (int i = 0; i < engines; i++)
+    // Prepare engine names: blank for now, will be set later
+    for (int i = 0; i < engines; i++) {
         vec_push(jq.names, str_init());
+        vec_push(jq.byes, 0);
+        vec_push(jq.eliminated, false);
+    }
+
+    if (tournament == TOURNAMENT_SWISS) {
+        // Swiss: results for all N(N-1)/2 pairs, in round robin order, but only the first round is
+        // generated now. Each round plays floor(N/2) pairs.
+        for (int e1 = 0; e1 < engines - 1; e1++)
+            for (int e2 = e1 + 1; e2 < engines; e2++) {
+                const Result r = {.ei = {e1, e2}, .count = {0}, .penta = {0}};
+                vec_push(jq.results, r);
+            }
+
+        job_queue_swiss_round(&jq);
+        jq.count = (size_t)rounds * (size_t)(engines / 2) * (size_t)games;
+        return jq;
+    } else if (tournament == TOURNAMENT_RACE) {
+        // Race: results for all N(N-1)/2 pairs, in round robin order, but only the first stage is
+        // generated now. The number of jobs is not known in advance: start with an upper bound, which
+        // is adjusted when the race is over.
+        for (int e1 = 0; e1 < engines - 1; e1++)
+            for (int e2 = e1 + 1; e2 < engines; e2++) {
+                const Result r = {.ei = {e1, e2}, .count = {0}, .penta = {0}};
+                vec_push(jq.results, r);
+            }
 
-    if (gauntlet) {
+        job_queue_race_pairs(&jq);
+        jq.count = (size_t)rounds * vec_size(jq.pairs) * (size_t)games;
+        return jq;
+    } else if (tournament == TOURNAMENT_GAUNTLET) {
         // Gauntlet: N-1 pairs (0, e2) with 0 < e2
         for (int e2 = 1; e2 < engines; e2++) {
-            const Result r = {.ei = {0, e2}, .count = {0}, {0}};
+            const Result r = {.ei = {0, e2}, .count = {0}, .penta = {0}};
             vec_push(jq.results, r);
         }
-
-        for (int r = 0; r < rounds; r++) {
-            int added = 0;  // number of games already added to the current round
-
-            for (int e2 = 1; e2 < engines; e2++)
-                job_queue_init_pair(games, 0, e2, e2 - 1, &added, r, &jq.jobs);
-        }
     } else {
         // Round robin: N(N-1)/2 pairs (e1, e2) with e1 < e2
         for (int e1 = 0; e1 < engines - 1; e1++)
             for (int e2 = e1 + 1; e2 < engines; e2++) {
-                const Result r = {.ei = {e1, e2}, .count = {0}, {0}};
+                const Result r = {.ei = {e1, e2}, .count = {0}, .penta = {0}};
                 vec_push(jq.results, r);
             }
-
-        for (int r = 0; r < rounds; r++) {
-            int pair = 0;  // enumerate pairs in order
-            int added = 0;  // number of games already added to the current round
-
-            for (int e1 = 0; e1 < engines - 1; e1++)
-                for (int e2 = e1 + 1; e2 < engines; e2++)
-                    job_queue_init_pair(games, e1, e2, pair++, &added, r, &jq.jobs);
-        }
     }
 
+    // Every round plays all pairs, in order. Jobs are computed on demand by job_queue_job(), so
+    // memory use does not depend on the number of games.
+    for (size_t pair = 0; pair < vec_size(jq.results); pair++)
+        vec_push(jq.pairs, (int)pair);
+
+    jq.count = (size_t)rounds * vec_size(jq.pairs) * (size_t)games;
     return jq;
 }
 
 void job_queue_destroy(JobQueue *jq)
 {
     vec_destroy(jq->results);
-    vec_destroy(jq->jobs);
+    vec_destroy(jq->pending);
+
+    for (size_t i = 0; i < vec_size(jq->groups); i++)
+        pthread_mutex_destroy(&jq->groups[i].mtx);
+
+    vec_destroy(jq->groups);
+    vec_destroy(jq->pairs);
     vec_destroy_rec(jq->names, str_destroy);
+    vec_destroy(jq->byes);
+    vec_destroy(jq->eliminated);
+    pthread_cond_destroy(&jq->cond);
     pthread_mutex_destroy(&jq->mtx);
 }
 
-bool job_queue_pop(JobQueue *jq, Job *j, size_t *idx, size_t *count)
+void job_queue_init_groups(JobQueue *jq, int groups)
+// NUMA: workers are partitioned in groups, each consuming blocks of jobs. Only for tournaments whose
+// jobs are all known upfront (not Swiss or race, where groups are ignored).
+{
+    if (jq->tournament == TOURNAMENT_SWISS || jq->tournament == TOURNAMENT_RACE)
+        return;
+
+    for (int i = 0; i < groups; i++) {
+        vec_push(jq->groups, (JobGroup){0});
+        pthread_mutex_init(&jq->groups[i].mtx, NULL);
+    }
+}
+
+static bool job_queue_pop_group(JobQueue *jq, int group, Job *j, size_t *idx, size_t *count)
+// Take the next job of the group's block. When empty, claim a new block from the queue, so that
+// the shared state is touched once per block, rather than once per job. When the queue is empty,
+// steal jobs from the end of other groups' blocks.
 {
+    enum {BLOCK = 16};  // even, so that game pairs (-repeat) are not split between groups
+
+    JobGroup *g = &jq->groups[group];
+    pthread_mutex_lock(&g->mtx);
+
+    if (g->idx == g->end) {
+        pthread_mutex_lock(&jq->mtx);
+        g->idx = jq->idx;
+        g->end = jq->idx = min(jq->idx + BLOCK, jq->count);
+        g->count = jq->count;
+        pthread_mutex_unlock(&jq->mtx);
+    }
+
+    bool ok = g->idx < g->end;
+
+    if (ok) {
+        *idx = g->idx++;
+        *count = g->count;
+    }
+
+    pthread_mutex_unlock(&g->mtx);
+
+    for (size_t i = 1; !ok && i < vec_size(jq->groups); i++) {
+        JobGroup *victim = &jq->groups[((size_t)group + i) % vec_size(jq->groups)];
+        pthread_mutex_lock(&victim->mtx);
+
+        if ((ok = victim->idx < victim->end)) {
+            *idx = --victim->end;
+            *count = victim->count;
+        }
+
+        pthread_mutex_unlock(&victim->mtx);
+    }
+
+    // Pairs are not modified after job_queue_init() for these tournaments: no lock needed
+    if (ok)
+        *j = job_queue_job(jq, *idx);
+
+    return ok;
+}
+
+bool job_queue_pop(JobQueue *jq, int group, Job *j, size_t *idx, size_t *count)
+{
+    if (vec_size(jq->groups))
+        return job_queue_pop_group(jq, group, j, idx, count);
+
     pthread_mutex_lock(&jq->mtx);
-    const bool ok = jq->idx < vec_size(jq->jobs);
+
+    // Swiss/race: wait for the current round to be completed, before pairing the next one (race stages
+    // are generated by job_queue_add_result() instead). Open queue: wait for more jobs.
+    while (jq->idx == job_queue_generated(jq) && (jq->idx < jq->count || jq->open)) {
+        if (jq->idx < jq->count && jq->completed == job_queue_generated(jq))
+            job_queue_swiss_round(jq);
+        else
+            pthread_cond_wait(&jq->cond, &jq->mtx);
+    }
+
+    const bool ok = jq->idx < jq->count;
 
     if (ok) {
-        *j = jq->jobs[jq->idx];
+        *j = job_queue_job(jq, jq->idx);
         *idx = jq->idx++;
-        *count = vec_size(jq->jobs);
+        *count = jq->count;
+        jq->started++;
+    }
+
+    pthread_mutex_unlock(&jq->mtx);
+    return ok;
+}
+
+// Pop 2 consecutive jobs atomically (for 2 engines and an even number of games, this is a pair of
+// games with colors reversed)
+bool job_queue_pop_pair(JobQueue *jq, Job j[2], size_t idx[2], size_t *count)
+{
+    pthread_mutex_lock(&jq->mtx);
+
+    while (jq->idx + 1 >= jq->count && jq->open)
+        pthread_cond_wait(&jq->cond, &jq->mtx);
+
+    const bool ok = jq->idx + 1 < jq->count;
+
+    if (ok) {
+        for (int i = 0; i < 2; i++) {
+            j[i] = job_queue_job(jq, jq->idx);
+            idx[i] = jq->idx++;
+        }
+
+        *count = jq->count;
+        jq->started += 2;
     }
 
     pthread_mutex_unlock(&jq->mtx);
@@ -104,34 +478,122 @@ bool job_queue_pop(JobQueue *jq, Job *j, size_t *idx, size_t *count)
 }
 
 // Add game outcome, and return updated totals
-void job_queue_add_result(JobQueue *jq, int pair, int outcome, int count[3])
+void job_queue_add_result(JobQueue *jq, size_t idx, int pair, int outcome, int count[3])
 {
     pthread_mutex_lock(&jq->mtx);
     jq->results[pair].count[outcome]++;
     jq->completed++;
 
+    // With an even number of games per pair, jobs (2k, 2k+1) are played by the same engines, on the
+    // same opening (if -repeat), with colors reversed
+    if (jq->games % 2 == 0) {
+        size_t i = 0;
+
+        while (i < vec_size(jq->pending) && jq->pending[i].gamePair != idx / 2)
+            i++;
+
+        if (i < vec_size(jq->pending)) {
+            jq->results[pair].penta[jq->pending[i].outcome + outcome]++;
+            jq->pending[i] = jq->pending[vec_size(jq->pending) - 1];
+            vec_pop(jq->pending);
+        } else {
+            const PendingPair pp = {.gamePair = idx / 2, .outcome = outcome};
+            vec_push(jq->pending, pp);
+        }
+    }
+
+    // Race: decide the next stage as soon as the current one is completed (unless the queue was
+    // stopped, or the race is already over)
+    if (jq->tournament == TOURNAMENT_RACE && jq->completed == job_queue_generated(jq)
+            && (jq->completed < jq->count || jq->round == jq->rounds))
+        job_queue_race_stage(jq);
+
     for (size_t i = 0; i < 3; i++)
         count[i] = jq->results[pair].count[i];
 
+    pthread_cond_broadcast(&jq->cond);
     pthread_mutex_unlock(&jq->mtx);
 }
 
 bool job_queue_done(JobQueue *jq)
+// All jobs were handed out, including those of each group's block
 {
+    // Lock groups before the queue (same order as job_queue_pop_group()), and hold them all, so that
+    // no block is claimed in between
+    bool done = true;
+
+    for (size_t i = 0; i < vec_size(jq->groups); i++) {
+        pthread_mutex_lock(&jq->groups[i].mtx);
+        done = done && jq->groups[i].idx == jq->groups[i].end;
+    }
+
     pthread_mutex_lock(&jq->mtx);
-    assert(jq->idx <= vec_size(jq->jobs));
-    const bool done = jq->idx == vec_size(jq->jobs);
+    assert(jq->idx <= jq->count);
+    done = done && jq->idx == jq->count && !jq->open;
     pthread_mutex_unlock(&jq->mtx);
+
+    for (size_t i = 0; i < vec_size(jq->groups); i++)
+        pthread_mutex_unlock(&jq->groups[i].mtx);
+
     return done;
 }
 
 void job_queue_stop(JobQueue *jq)
 {
     pthread_mutex_lock(&jq->mtx);
-    jq->idx = vec_size(jq->jobs);
+    jq->count = jq->idx = job_queue_generated(jq);
+    pthread_cond_broadcast(&jq->cond);
+    pthread_mutex_unlock(&jq->mtx);
+
+    // Discard the jobs of each group's block (lock groups after the queue is released, because
+    // job_queue_pop_group() locks them in the opposite order)
+    for (size_t i = 0; i < vec_size(jq->groups); i++) {
+        pthread_mutex_lock(&jq->groups[i].mtx);
+        jq->groups[i].end = jq->groups[i].idx;
+        pthread_mutex_unlock(&jq->groups[i].mtx);
+    }
+}
+
+size_t job_queue_submit(JobQueue *jq, int rounds)
+// Open queue: append rounds (each one plays every pair of the tournament, as in -rounds). Returns the
+// number of jobs added, or 0 if the queue is closed, or the tournament is a race (whose number of
+// stages is decided as it goes).
+{
+    pthread_mutex_lock(&jq->mtx);
+    size_t added = 0;
+
+    if (jq->open && jq->tournament != TOURNAMENT_RACE) {
+        const size_t pairs = jq->tournament == TOURNAMENT_SWISS ? (size_t)(jq->engines / 2)
+            : vec_size(jq->pairs);
+        added = (size_t)rounds * pairs * (size_t)jq->games;
+        jq->rounds += rounds;
+        jq->count += added;
+        pthread_cond_broadcast(&jq->cond);
+    }
+
+    pthread_mutex_unlock(&jq->mtx);
+    return added;
+}
+
+void job_queue_close(JobQueue *jq)
+// No more jobs will be submitted: waiting workers return, once the queue is empty
+{
+    pthread_mutex_lock(&jq->mtx);
+    jq->open = false;
+    pthread_cond_broadcast(&jq->cond);
     pthread_mutex_unlock(&jq->mtx);
 }
 
+bool job_queue_finished(JobQueue *jq, size_t played)
+// True if there is no job left, and all the jobs handed out were played ('played' is counted by the
+// caller, after processing their results)
+{
+    pthread_mutex_lock(&jq->mtx);
+    const bool finished = jq->idx == jq->count && played == jq->started;
+    pthread_mutex_unlock(&jq->mtx);
+    return finished;
+}
+
 void job_queue_set_name(JobQueue *jq, int ei, const char *name)
 {
     pthread_mutex_lock(&jq->mtx);
@@ -146,7 +608,13 @@ void job_queue_print_results(JobQueue *jq, size_t frequency)
 {
     pthread_mutex_lock(&jq->mtx);
 
-    if (jq->completed && jq->completed % frequency == 0) {
+    if (jq->tournament == TOURNAMENT_SWISS) {
+        // Standings after intermediate rounds are printed by job_queue_swiss_round()
+        if (jq->completed == jq->count)
+            job_queue_print_standings(jq);
+    } else if (jq->tournament == TOURNAMENT_RACE) {
+        // Rankings are printed by job_queue_race_stage()
+    } else if (jq->completed && jq->completed % frequency == 0) {
         scope(str_destroy) str_t out = str_init_from_c("Tournament update:\n");
 
         for (size_t i = 0; i < vec_size(jq->results); i++) {
@@ -162,8 +630,161 @@ void job_queue_print_results(JobQueue *jq, size_t frequency)
             }
         }
 
-        fputs(out.buf, stdout);
+        fputs(out.buf, jq->out);
+    }
+
+    pthread_mutex_unlock(&jq->mtx);
+}
+
+static void job_queue_write_results(FILE *out, const str_t *names, const Result *results)
+// One line per pair: "e1<TAB>e2<TAB>W L D<TAB>P0 P1 P2 P3 P4" from e1's pov
+{
+    for (size_t i = 0; i < vec_size(results); i++) {
+        const Result *r = &results[i];
+        DIE_IF(0, fprintf(out, "%s\t%s\t%d %d %d\t%d %d %d %d %d\n", names[r->ei[0]].buf,
+            names[r->ei[1]].buf, r->count[RESULT_WIN], r->count[RESULT_LOSS],
+            r->count[RESULT_DRAW], r->penta[0], r->penta[1], r->penta[2], r->penta[3],
+            r->penta[4]) < 0);
     }
+}
+
+static void job_queue_write_results_file(const char *fileName, const str_t *names,
+    const Result *results)
+// Write to a temporary file first, so that fileName is always a complete checkpoint
+{
+    scope(str_destroy) str_t tmpName = str_init_from_c(fileName);
+    str_cat_c(&tmpName, ".tmp");
 
+    FILE *out = fopen(tmpName.buf, "we");
+    DIE_IF(0, !out);
+    job_queue_write_results(out, names, results);
+    DIE_IF(0, fclose(out) < 0);
+    DIE_IF(0, rename(tmpName.buf, fileName) < 0);
+}
+
+void job_queue_save_results(JobQueue *jq, const char *fileName)
+{
+    pthread_mutex_lock(&jq->mtx);
+    job_queue_write_results_file(fileName, jq->names, jq->results);
     pthread_mutex_unlock(&jq->mtx);
 }
+
+static int job_queue_find_name(str_t **names, const char *name)
+{
+    for (size_t i = 0; i < vec_size(*names); i++)
+        if (!strcmp((*names)[i].buf, name))
+            return (int)i;
+
+    vec_push(*names, str_init_from_c(name));
+    return (int)vec_size(*names) - 1;
+}
+
+static void job_queue_load_results(const char *fileName, str_t **names, Result **results)
+// Add the results of fileName to (names, results). Pairs are identified by engine names, in any
+// order (counts are flipped as needed).
+{
+    FILE *in = fopen(fileName, "re");
+    DIE_IF(0, !in);
+
+    scope(str_destroy) str_t line = str_init(), name1 = str_init(), name2 = str_init();
+
+    while (str_getline(&line, in)) {
+        const char *tail = str_tok(str_tok(line.buf, &name1, "\t"), &name2, "\t");
+        int wld[3] = {0}, penta[5] = {0};
+
+        if (!tail || sscanf(tail, "%d %d %d %d %d %d %d %d", &wld[RESULT_WIN], &wld[RESULT_LOSS],
+                &wld[RESULT_DRAW], &penta[0], &penta[1], &penta[2], &penta[3], &penta[4]) != 8)
+            DIE("Invalid line in results file '%s': '%s'\n", fileName, line.buf);
+
+        const int e1 = job_queue_find_name(names, name1.buf);
+        const int e2 = job_queue_find_name(names, name2.buf);
+        size_t i = 0;
+
+        while (i < vec_size(*results) && !((*results)[i].ei[0] == e1 && (*results)[i].ei[1] == e2)
+                && !((*results)[i].ei[0] == e2 && (*results)[i].ei[1] == e1))
+            i++;
+
+        if (i == vec_size(*results)) {
+            const Result r = {.ei = {e1, e2}, .count = {0}, .penta = {0}};
+            vec_push(*results, r);
+        }
+
+        Result *r = &(*results)[i];
+        const bool flip = r->ei[0] != e1;
+
+        for (int j = 0; j < 3; j++)
+            r->count[flip ? 2 - j : j] += wld[j];
+
+        for (int j = 0; j < 5; j++)
+            r->penta[flip ? 4 - j : j] += penta[j];
+    }
+
+    DIE_IF(0, fclose(in) < 0);
+}
+
+static double score_to_elo(double score)
+{
+    return 400 * log10(score / (1 - score));
+}
+
+void job_queue_merge_results(const str_t *fileNames, const SPRTParam *sp, const char *outName)
+// Merge results files from independent runs, print a report for each pair, and an SPRT decision
+// (if sp is not NULL, for a single pair). The merged results are written to outName (if any).
+{
+    str_t *names = vec_init(str_t);
+    Result *results = vec_init(Result);
+
+    for (size_t i = 0; i < vec_size(fileNames); i++)
+        job_queue_load_results(fileNames[i].buf, &names, &results);
+
+    scope(str_destroy) str_t out = str_init();
+    str_cpy_fmt(&out, "Merged %u results files:\n", (unsigned)vec_size(fileNames));
+
+    for (size_t i = 0; i < vec_size(results); i++) {
+        const Result *r = &results[i];
+        const int n = r->count[RESULT_WIN] + r->count[RESULT_LOSS] + r->count[RESULT_DRAW];
+        const int pairs = r->penta[0] + r->penta[1] + r->penta[2] + r->penta[3] + r->penta[4];
+
+        if (!n)
+            continue;
+
+        // Standard error of the score: per game pair if available (accounts for the correlation
+        // between the 2 games of a pair), otherwise per game.
+        const double score = (r->count[RESULT_WIN] + 0.5 * r->count[RESULT_DRAW]) / n;
+        double variance = 0;
+
+        if (pairs) {
+            for (int j = 0; j < 5; j++)
+                variance += r->penta[j] * (j / 4.0 - score) * (j / 4.0 - score);
+
+            variance /= (double)pairs * pairs;
+        } else
+            variance = ((r->count[RESULT_WIN] + 0.25 * r->count[RESULT_DRAW]) / n - score * score) / n;
+
+        const double error = 1.96 * sqrt(variance);
+
+        char buf[64] = "";
+        sprintf(buf, "[%.3f] %.1f +/- %.1f elo", score, score_to_elo(score),
+            (score_to_elo(fmin(score + error, 0.999)) - score_to_elo(fmax(score - error, 0.001))) / 2);
+        str_cat_fmt(&out, "%S vs %S: %i - %i - %i  %s, %i games", names[r->ei[0]],
+            names[r->ei[1]], r->count[RESULT_WIN], r->count[RESULT_LOSS], r->count[RESULT_DRAW], buf,
+            n);
+
+        if (pairs)
+            str_cat_fmt(&out, ", pentanomial %i %i %i %i %i", r->penta[0], r->penta[1],
+                r->penta[2], r->penta[3], r->penta[4]);
+
+        str_push(&out, '\n');
+    }
+
+    fputs(out.buf, stdout);
+
+    if (sp && vec_size(results) == 1)
+        sprt_done(results[0].count, sp, stdout);
+
+    if (outName)
+        job_queue_write_results_file(outName, names, results);
+
+    vec_destroy(results);
+    vec_destroy_rec(names, str_destroy);
+}
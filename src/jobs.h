@@ -13,17 +13,45 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include "sprt.h"
 #include "str.h"
 
+enum {
+    TOURNAMENT_ROUND_ROBIN,
+    TOURNAMENT_GAUNTLET,
+    TOURNAMENT_SWISS,
+    TOURNAMENT_RACE
+};
+
+// Race: successive halving. Candidates whose score is not at least z standard errors below the last
+// survivor are not eliminated. If reference is set, engine 0 is not a candidate, and candidates only
+// play against it.
+typedef struct {
+    double z;
+    bool reference;
+    char pad[7];
+} RaceParam;
+
 // Result for each pair (e1, e2); e1 < e2. Stores count of game outcomes from e1's point of view.
+// With an even number of games per pair, games are also counted by game pairs (same opening with
+// colors reversed): penta[n] counts game pairs where e1 scored n half points.
 typedef struct {
     int ei[2];
     int count[3];
-    char pad[4];
+    int penta[5];
 } Result;
 
+// Game pair waiting for its second game to complete
+typedef struct {
+    size_t gamePair;  // idx / 2
+    int outcome;  // outcome of the first game to complete, from e1's pov
+    char pad[4];
+} PendingPair;
+
 // Job: instruction to play a single game
 typedef struct {
     int ei[2], pair;  // ei[0] plays ei[1]
@@ -32,23 +60,54 @@ typedef struct {
     char pad[3];
 } Job;
 
+// NUMA: block of jobs [idx, end) claimed from the queue by a group of workers (thread safe)
+typedef struct {
+    pthread_mutex_t mtx;
+    size_t idx, end;
+    size_t count;  // total number of jobs, when the block was claimed
+} JobGroup;
+
 // Job Queue: consumed by workers to play tournament (thread safe)
 typedef struct {
     pthread_mutex_t mtx;
-    Job *jobs;
+    pthread_cond_t cond;  // signaled when a result is added (Swiss/race: waiting for the round to end)
+    int *pairs;  // pairs played in each round (Swiss/race: in the current round), indexes results[]
+    size_t first;  // Swiss/race: index of the first job of the current round
     size_t idx;  // next job index
     size_t completed;  // number of jobs completed
+    size_t started;  // number of jobs handed out (not counted for job groups)
+    size_t count;  // total number of jobs (race: upper bound, until the race is over)
     str_t *names;
     Result *results;
+    PendingPair *pending;
+    JobGroup *groups;  // NUMA: one per node (none if disabled)
+    int *byes;  // Swiss: number of byes received by each engine
+    bool *eliminated;  // race: engines eliminated so far
+    FILE *out;  // reports (standings, race stages, tournament updates): stdout by default
+    RaceParam race;
+    int tournament, engines, rounds, games;
+    int round;  // Swiss/race: number of rounds generated so far
+    bool open;  // more jobs may be submitted: workers wait for them, instead of returning
+    char pad[3];
 } JobQueue;
 
-JobQueue job_queue_init(int engines, int rounds, int games, bool gauntlet);
+JobQueue job_queue_init(int engines, int rounds, int games, int tournament, const RaceParam *rp);
 void job_queue_destroy(JobQueue *jq);
 
-bool job_queue_pop(JobQueue *jq, Job *j, size_t *idx, size_t *count);
-void job_queue_add_result(JobQueue *jq, int pair, int outcome, int count[3]);
+void job_queue_init_groups(JobQueue *jq, int groups);
+
+bool job_queue_pop(JobQueue *jq, int group, Job *j, size_t *idx, size_t *count);
+bool job_queue_pop_pair(JobQueue *jq, Job j[2], size_t idx[2], size_t *count);
+void job_queue_add_result(JobQueue *jq, size_t idx, int pair, int outcome, int count[3]);
 bool job_queue_done(JobQueue *jq);
 void job_queue_stop(JobQueue *jq);
 
+size_t job_queue_submit(JobQueue *jq, int rounds);
+void job_queue_close(JobQueue *jq);
+bool job_queue_finished(JobQueue *jq, size_t played);
+
 void job_queue_set_name(JobQueue *jq, int ei, const char *name);
 void job_queue_print_results(JobQueue *jq, size_t frequency);
+void job_queue_save_results(JobQueue *jq, const char *fileName);
+
+void job_queue_merge_results(const str_t *fileNames, const SPRTParam *sp, const char *outName);
@@ -12,38 +12,22 @@
  * You should have received a copy of the GNU General Public License along with this program. If
  * not, see <http://www.gnu.org/licenses/>.
 */
-#include <pthread.h>
 #include <stdlib.h>
 #include "engine.h"
-#include "game.h"
+#include "gamedb.h"
 #include "jobs.h"
-#include "openings.h"
+#include "match.h"
+#include "memstats.h"
 #include "options.h"
-#include "seqwriter.h"
 #include "sprt.h"
-#include "util.h"
 #include "vec.h"
-#include "workers.h"
 
 static Options options;
 static EngineOptions *eo;
-static Openings openings;
-static SeqWriter pgnSeqWriter;
-FILE *sampleFile;
-static JobQueue jq;
 
 static void main_destroy(void)
 {
-    vec_destroy_rec(Workers, worker_destroy);
-
-    if (options.sample.len)
-        fclose(sampleFile);
-
-    if (options.pgn.len)
-        seq_writer_destroy(&pgnSeqWriter);
-
-    openings_destroy(&openings, 0);
-    job_queue_destroy(&jq);
+    match_destroy();
     options_destroy(&options);
     vec_destroy_rec(eo, engine_options_destroy);
 }
@@ -56,143 +40,49 @@ static void main_init(int argc, const char **argv)
     options = options_init();
     options_parse(argc, argv, &options, &eo);
 
-    jq = job_queue_init(vec_size(eo), options.rounds, options.games, options.gauntlet);
-    openings = openings_init(options.openings.buf, options.random, options.srand, 0);
-
-    if (options.pgn.len)
-        pgnSeqWriter = seq_writer_init(options.pgn.buf, "ae");
-
-    if (options.sample.len)
-        DIE_IF(0, !(sampleFile = fopen(options.sample.buf, "ae")));
-
-    // Prepare Workers[]
-    Workers = vec_init(Worker);
-
-    for (int i = 0; i < options.concurrency; i++) {
-        scope(str_destroy) str_t logName = str_init();
-
-        if (options.log)
-            str_cat_fmt(&logName, "c-chess-cli.%i.log", i + 1);
+    // Engine server: serve engines to remote instances (never returns)
+    if (options.serveParam.port)
+        engine_serve(options.serveParam.cmd.buf, options.serveParam.address.buf,
+            options.serveParam.port);
 
-        vec_push(Workers, worker_init(i, logName.buf));
+    // Simulation mode: no engines, no games
+    if (options.sprtSim) {
+        sprt_simulate(&options.sprtParam, &options.sprtSimParam, options.concurrency);
+        exit(0);
     }
-}
-
-static void *thread_start(void *arg)
-{
-    Worker *w = arg;
-    Engine engines[2] = {0};
-
-    scope(str_destroy) str_t fen = str_init();
-    Job job = {0};
-    int ei[2] = {-1, -1};  // eo[ei[0]] plays eo[ei[1]]: initialize with invalid values to start
-    size_t idx = 0, count = 0;  // game idx and count (shared across workers)
-
-    while (job_queue_pop(&jq, &job, &idx, &count)) {
-        // Engine stop/start, as needed
-        for (int i = 0; i < 2; i++)
-            if (job.ei[i] != ei[i]) {
-                if (engines[i].pid)
-                    engine_destroy(w, &engines[i]);
-
-                ei[i] = job.ei[i];
-                engines[i] = engine_init(w, eo[ei[i]].cmd.buf, eo[ei[i]].name.buf, eo[ei[i]].options);
-                job_queue_set_name(&jq, ei[i], engines[i].name.buf);
-            }
-
-        // Choose opening position
-        openings_next(&openings, &fen, options.repeat ? idx / 2 : idx, w->id);
-
-        // Play 1 game
-        Game game = game_init(job.round, job.game);
-        int color = WHITE;
 
-        if (!game_load_fen(&game, fen.buf, &color))
-            DIE("[%d] illegal FEN '%s'\n", w->id, fen.buf);
-
-        const int whiteIdx = color ^ job.reverse;
-
-        printf("[%d] Started game %zu of %zu (%s vs %s)\n", w->id, idx + 1, count,
-            engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf);
-
-        const EngineOptions *eoPair[2] = {&eo[ei[0]], &eo[ei[1]]};
-        const int wld = game_play(w, &game, &options, engines, eoPair, job.reverse);
-
-        // Write to PGN file
-        if (options.pgn.len) {
-            scope(str_destroy) str_t pgnText = str_init();
-            game_export_pgn(&game, options.pgnVerbosity, &pgnText);
-            seq_writer_push(&pgnSeqWriter, idx, pgnText);
-        }
-
-        // Write to Sample file
-        if (options.sample.len) {
-            scope(str_destroy) str_t sampleText = str_init();
-            game_export_samples(&game, &sampleText);
-            fputs(sampleText.buf, sampleFile);
-        }
-
-        // Write to stdout a one line summary of the game
-        scope(str_destroy) str_t result = str_init(), reason = str_init();
-        game_decode_state(&game, &result, &reason);
-
-        printf("[%d] Finished game %zu (%s vs %s): %s {%s}\n", w->id, idx + 1,
-            engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf, result.buf, reason.buf);
-
-        // Pair update
-        int wldCount[3] = {0};
-        job_queue_add_result(&jq, job.pair, wld, wldCount);
-        const int n = wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
-        printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n", engines[0].name.buf,
-            engines[1].name.buf, wldCount[RESULT_WIN], wldCount[RESULT_LOSS], wldCount[RESULT_DRAW],
-            (wldCount[RESULT_WIN] + 0.5 * wldCount[RESULT_DRAW]) / n, n);
-
-        // SPRT update
-        if (options.sprt && sprt_done(wldCount, &options.sprtParam))
-            job_queue_stop(&jq);
-
-        // Tournament update
-        if (vec_size(eo) > 2)
-            job_queue_print_results(&jq, (size_t)options.games);
+    // Query mode: read a game database, no games
+    if (options.query.file.len) {
+        gamedb_query(&options.query);
+        exit(0);
+    }
 
-        game_destroy(&game);
+    // Adjudication simulation: replay recorded games, no games played
+    if (options.adjSimParam.pgn.len) {
+        adjsim_run(&options.adjSimParam, options.concurrency);
+        exit(0);
     }
 
-    for (int i = 0; i < 2; i++)
-        engine_destroy(w, &engines[i]);
+    // Merge mode: combine results files from independent runs, no games
+    if (vec_size(options.merge)) {
+        job_queue_merge_results(options.merge, options.sprt ? &options.sprtParam : NULL,
+            options.results.len ? options.results.buf : NULL);
+        exit(0);
+    }
 
-    return NULL;
+    MemStats = options.memStats >= 0;
+    match_init(&options, eo, false);
 }
 
 int main(int argc, const char **argv)
 {
     main_init(argc, argv);
+    match_start();
+    match_monitor();
+    match_join();
 
-    // Start threads[]
-    pthread_t threads[options.concurrency];
-
-    for (int i = 0; i < options.concurrency; i++)
-        pthread_create(&threads[i], NULL, thread_start, &Workers[i]);
-
-    // Main thread loop: check deadline overdue at regular intervals
-    do {
-        system_sleep(100);
-
-        // We want some tolerance on small delays here. Given a choice, it's best to wait for the
-        // worker thread to notice an overdue deadline, which it will handled nicely by counting the
-        // game as lost for the offending engine, and continue. Enforcing deadlines from the master
-        // thread is the last resort solution, because it is an unrecovrable error. At this point we
-        // are likely to face a completely unresponsive engine, where any attempt at I/O will block
-        // the master thread, on top of the already blocked worker. Hence, we must DIE().
-        for (int i = 0; i < options.concurrency; i++)
-            if (deadline_overdue(&Workers[i]) > 1000)
-                DIE("[%d] engine %s is unresponsive\n", Workers[i].id,
-                    Workers[i].deadline.engineName.buf);
-    } while (!job_queue_done(&jq));
-
-    // Join threads[]
-    for (int i = 0; i < options.concurrency; i++)
-        pthread_join(threads[i], NULL);
+    if (MemStats)
+        memstats_print(stdout);
 
     return 0;
 }
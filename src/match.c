@@ -0,0 +1,558 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "balance.h"
+#include "engine.h"
+#include "game.h"
+#include "jobs.h"
+#include "match.h"
+#include "memstats.h"
+#include "numa.h"
+#include "perf.h"
+#include "openings.h"
+#include "seqwriter.h"
+#include "spsa.h"
+#include "sprt.h"
+#include "util.h"
+#include "vec.h"
+#include "workers.h"
+
+static Options *options;
+static EngineOptions *eo;
+static Openings openings;
+static Openings *nodeOpenings;  // NUMA: one handle per node (shares the index of openings)
+static SeqWriter pgnSeqWriter;
+static GameDB gameDB;
+static FILE *sampleFile;
+static JobQueue jq;
+static SPSA spsa;
+static Adjudicator adjudicator;
+static pthread_t *threads;
+static bool library;
+
+// Library: outputs buffered in memory, until read by the host program
+static struct {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;  // signaled when a game is played
+    CCCResult *results;
+    size_t resultsRead;  // results[resultsRead...] are not read yet
+    str_t samples;
+    size_t samplesRead;  // samples.buf[samplesRead...] are not read yet
+    size_t played;  // number of games played (and buffered)
+} output;
+
+void match_init(Options *o, EngineOptions *e, bool lib)
+{
+    options = o;
+    eo = e;
+    library = lib;
+
+    // Hardware counters: before any engine is started (balance pass, adjudicator pool, workers)
+    if (options->perf)
+        perf_init((int)vec_size(eo), options->concurrency, library ? stderr : stdout);
+
+    jq = job_queue_init(vec_size(eo), options->rounds, options->games, options->tournament,
+        &options->raceParam);
+    jq.open = library;
+    jq.out = library ? stderr : stdout;
+
+    // Engine names not provided by the user will be discovered at run time (concurrently)
+    for (size_t i = 0; i < vec_size(eo); i++)
+        if (eo[i].name.len)
+            job_queue_set_name(&jq, (int)i, eo[i].name.buf);
+
+    if (library) {
+        pthread_mutex_init(&output.mtx, NULL);
+        pthread_cond_init(&output.cond, NULL);
+        output.results = vec_init(CCCResult);
+
+        int memTag = memstats_enter(MEM_SAMPLES);
+        output.samples = str_init();
+        memstats_leave(&memTag);
+    }
+
+    if (options->spsa)
+        spsa = spsa_init(&options->spsaParam, library ? stderr : stdout);
+
+    if (options->pgn.len) {
+        scope(str_destroy) str_t indexName = str_init_from(options->pgn);
+        str_cat_c(&indexName, ".idx");
+        pgnSeqWriter = seq_writer_init(options->pgn.buf, "ae",
+            options->pgnIndex ? indexName.buf : NULL);
+    }
+
+    if (options->gamedb.len)
+        gameDB = gamedb_init(options->gamedb.buf);
+
+    if (options->sample.len && !library)
+        DIE_IF(0, !(sampleFile = fopen(options->sample.buf, "ae")));
+
+    // Prepare Workers[]
+    Workers = vec_init(Worker);
+
+    for (int i = 0; i < options->concurrency; i++) {
+        scope(str_destroy) str_t logName = str_init();
+
+        if (options->log)
+            str_cat_fmt(&logName, "c-chess-cli.%i.log", i + 1);
+
+        vec_push(Workers, worker_init(i, logName.buf, library ? stderr : stdout));
+    }
+
+    // Adjudicator pool: its engine threads have their own Workers[], after those playing games
+    if (options->adjudicatorParam.cmd.len) {
+        for (int i = options->concurrency;
+                i < options->concurrency + options->adjudicatorParam.pool; i++) {
+            scope(str_destroy) str_t logName = str_init();
+
+            if (options->log)
+                str_cat_fmt(&logName, "c-chess-cli.%i.log", i + 1);
+
+            vec_push(Workers, worker_init(i, logName.buf, library ? stderr : stdout));
+        }
+
+        adjudicator = adjudicator_init(&options->adjudicatorParam, &Workers[options->concurrency],
+            options->concurrency);
+    }
+
+    // NUMA: split workers into contiguous groups, one per node, each with its own block of jobs
+    // (SPSA pops pairs of jobs from the shared queue, and the library counts jobs as they are handed
+    // out, which job groups do not)
+    if (options->numa) {
+        const int nodes = numa_init();
+        fprintf(library ? stderr : stdout, "NUMA: %d node(s)\n", nodes);
+
+        for (int i = 0; i < options->concurrency; i++)
+            Workers[i].node = i * nodes / options->concurrency;
+
+        if (nodes > 1 && !options->spsa && !library)
+            job_queue_init_groups(&jq, nodes);
+    }
+
+    openings = openings_init(options->openings.buf, 0);
+
+    if (options->openingStats.len)
+        openings_load_stats(&openings, options->openingStats.buf);
+
+    if (options->balance) {
+        const EngineOptions *ref = &eo[options->balanceParam.engine];
+        scope(str_destroy) str_t cacheName = str_init();
+        str_cpy_fmt(&cacheName, "%S.balance", options->openings);
+        balance_filter(&openings, &options->balanceParam, ref->cmd.buf, ref->name.buf,
+            ref->options, cacheName.buf, options->concurrency, library ? stderr : stdout);
+    }
+
+    if (options->order == ORDER_RANDOM)
+        openings_random(&openings, options->srand);
+    else if (options->order == ORDER_WEIGHTED || options->order == ORDER_INFORMATIVE)
+        openings_weighted(&openings, options->order == ORDER_INFORMATIVE, options->srand, 0);
+
+    // NUMA: node-local handles, so that workers of different nodes do not contend on the book
+    if (vec_size(jq.groups)) {
+        nodeOpenings = vec_init(Openings);
+
+        for (size_t i = 0; i < vec_size(jq.groups); i++)
+            vec_push(nodeOpenings, openings_share(&openings, options->openings.buf, 0));
+    }
+}
+
+void match_destroy(void)
+// Release resources, without waiting for threads (also called on exit, after DIE())
+{
+    if (!options)
+        return;
+
+    vec_destroy_rec(Workers, worker_destroy);
+
+    if (sampleFile)
+        fclose(sampleFile);
+
+    if (options->pgn.len)
+        seq_writer_destroy(&pgnSeqWriter);
+
+    if (options->gamedb.len)
+        gamedb_destroy(&gameDB, jq.names);
+
+    if (options->openingStats.len && openings.stats)
+        openings_save_stats(&openings, options->openingStats.buf);
+
+    if (options->spsa)
+        spsa_destroy(&spsa);
+
+    if (options->numa)
+        numa_destroy();
+
+    if (options->perf)
+        perf_destroy();
+
+    if (library) {
+        vec_destroy(output.results);
+        str_destroy(&output.samples);
+        pthread_cond_destroy(&output.cond);
+        pthread_mutex_destroy(&output.mtx);
+    }
+
+    for (size_t i = 0; i < vec_size(nodeOpenings); i++)
+        openings_destroy(&nodeOpenings[i], 0);
+
+    vec_destroy(nodeOpenings);
+    openings_destroy(&openings, 0);
+    job_queue_destroy(&jq);
+    free(threads);
+
+    output = (typeof(output)){0};
+    sampleFile = NULL;
+    threads = NULL;
+    options = NULL;
+    eo = NULL;
+}
+
+static void start_engines(Worker *w, Engine engines[2], int ei[2], const Job *job)
+// Engine stop/start, as needed. With -selfplay, engines[1] shares the process of engines[0] when
+// possible.
+{
+    const bool share = options->selfPlay
+        && engine_options_same_process(&eo[job->ei[0]], &eo[job->ei[1]]);
+
+    // A shared engine must not outlive the process it borrows
+    if (engines[1].shared && job->ei[0] != ei[0]) {
+        engine_destroy(w, &engines[1]);
+        engines[1] = (Engine){0};
+        ei[1] = -1;
+    }
+
+    for (int i = 0; i < 2; i++)
+        if (job->ei[i] != ei[i]) {
+            if (engines[i].pid)
+                engine_destroy(w, &engines[i]);
+
+            ei[i] = job->ei[i];
+            engines[i] = i == 1 && share
+                ? engine_share(&engines[0], eo[ei[i]].name.buf)
+                : engine_init(w, eo[ei[i]].cmd.buf, eo[ei[i]].name.buf, eo[ei[i]].options);
+            job_queue_set_name(&jq, ei[i], engines[i].name.buf);
+        }
+}
+
+static void output_push(const Game *game, const Job *job, size_t idx, const int ei[2], int whiteIdx,
+    int result, const str_t *reason, const str_t *samples)
+// Library: buffer the outcome of a game (result from white's pov), and its samples
+{
+    CCCResult r = {
+        .idx = idx, .round = job->round, .game = job->game,
+        .white = ei[whiteIdx], .black = ei[opposite(whiteIdx)],
+        .result = result, .ply = game->ply
+    };
+    snprintf(r.reason, sizeof(r.reason), "%s", reason->buf);
+
+    pthread_mutex_lock(&output.mtx);
+    vec_push(output.results, r);
+    str_cat(&output.samples, *samples);
+    output.played++;
+    pthread_cond_broadcast(&output.cond);
+    pthread_mutex_unlock(&output.mtx);
+}
+
+static int play_job(Worker *w, const Engine engines[2], const int ei[2], const Job *job, size_t idx,
+    size_t count)
+// Play the game described by job (number idx of count), and process outputs. Returns the result
+// from engines[0]'s pov.
+{
+    scope(memstats_leave) int memTag = memstats_enter(MEM_GAMES);
+
+    // Choose opening position
+    scope(str_destroy) str_t fen = str_init();
+    Openings *book = nodeOpenings ? &nodeOpenings[w->node] : &openings;
+    const size_t opening = openings_next(book, &fen, options->repeat ? idx / 2 : idx, w->id);
+
+    // Play 1 game
+    Game game = game_init(job->round, job->game);
+    int color = WHITE;
+
+    if (!game_load_fen(&game, fen.buf, &color))
+        DIE("[%d] illegal FEN '%s'\n", w->id, fen.buf);
+
+    const int whiteIdx = color ^ job->reverse;
+
+    if (!library)
+        printf("[%d] Started game %zu of %zu (%s vs %s)\n", w->id, idx + 1, count,
+            engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf);
+
+    // Hardware counters of the engines, at the start of the game
+    uint64_t perfStart[2][NB_PERF] = {{0}};
+    int level = 0;  // concurrency level: number of games in progress
+
+    if (PerfStats) {
+        workers_busy_add(1);
+        level = workers_busy_count();
+
+        for (int i = 0; i < 2; i++)
+            perf_read(engines[i].perf, perfStart[i]);
+    }
+
+    const EngineOptions *eoPair[2] = {&eo[ei[0]], &eo[ei[1]]};
+    const int wld = game_play(w, &game, options, engines, eoPair, job->reverse,
+        options->adjudicatorParam.cmd.len ? &adjudicator : NULL);
+
+    if (PerfStats) {
+        // A shared engine is counted by the process owner (engines[0])
+        for (int i = 0; i < 2; i++)
+            if (!engines[i].shared)
+                perf_add(engines[i].perf, perfStart[i], ei[i], level);
+
+        workers_busy_add(-1);
+    }
+
+    // Record opening outcome (from white's pov)
+    if (options->openingStats.len)
+        openings_add_result(&openings, game.pos[0].key, whiteIdx == 0 ? wld : 2 - wld);
+
+    // Write to PGN file
+    if (options->pgn.len) {
+        scope(str_destroy) str_t pgnText = str_init();
+        game_export_pgn(&game, options->pgnVerbosity, &pgnText);
+        seq_writer_push(&pgnSeqWriter, idx, pgnText);
+    }
+
+    // Write to game database
+    if (options->gamedb.len) {
+        GameRecord r = {
+            .idx = idx, .opening = opening,
+            .ei = {(int16_t)ei[whiteIdx], (int16_t)ei[opposite(whiteIdx)]}
+        };
+        scope(str_destroy) str_t startFen = str_init();
+        move_t *moves = vec_init(move_t);
+        game_export_record(&game, &r, &startFen, &moves);
+        gamedb_push(&gameDB, &r, &startFen, moves);
+        vec_destroy(moves);
+    }
+
+    // Write to Sample file (library: buffered with the result below)
+    int samplesTag = memstats_enter(MEM_SAMPLES);
+    scope(str_destroy) str_t sampleText = str_init();
+    memstats_leave(&samplesTag);
+
+    if (options->sample.len) {
+        game_export_samples(&game, &sampleText);
+
+        if (!library)
+            fputs(sampleText.buf, sampleFile);
+    }
+
+    // Write to stdout a one line summary of the game
+    scope(str_destroy) str_t result = str_init(), reason = str_init();
+    game_decode_state(&game, &result, &reason);
+
+    if (!library)
+        printf("[%d] Finished game %zu (%s vs %s): %s {%s}\n", w->id, idx + 1,
+            engines[whiteIdx].name.buf, engines[opposite(whiteIdx)].name.buf, result.buf,
+            reason.buf);
+
+    // Pair update
+    int wldCount[3] = {0};
+    job_queue_add_result(&jq, idx, job->pair, wld, wldCount);
+    const int n = wldCount[RESULT_WIN] + wldCount[RESULT_LOSS] + wldCount[RESULT_DRAW];
+
+    if (!library)
+        printf("Score of %s vs %s: %d - %d - %d  [%.3f] %d\n", engines[0].name.buf,
+            engines[1].name.buf, wldCount[RESULT_WIN], wldCount[RESULT_LOSS],
+            wldCount[RESULT_DRAW], (wldCount[RESULT_WIN] + 0.5 * wldCount[RESULT_DRAW]) / n, n);
+
+    // Checkpoint results
+    if (options->results.len)
+        job_queue_save_results(&jq, options->results.buf);
+
+    // SPRT update
+    if (options->sprt && sprt_done(wldCount, &options->sprtParam, library ? stderr : stdout))
+        job_queue_stop(&jq);
+
+    // Tournament update
+    if (vec_size(eo) > 2 && !library)
+        job_queue_print_results(&jq, (size_t)options->games);
+
+    if (library)
+        output_push(&game, job, idx, ei, whiteIdx, whiteIdx == 0 ? wld : 2 - wld, &reason,
+            &sampleText);
+
+    game_destroy(&game);
+    return wld;
+}
+
+static void spsa_send_options(Worker *w, const Engine engines[2], const SPSAIteration *it)
+// engines[0] plays with it->plus, and engines[1] with it->minus
+{
+    scope(str_destroy) str_t cmd = str_init();
+
+    for (size_t i = 0; i < vec_size(it->delta); i++)
+        for (int e = 0; e < 2; e++) {
+            const double value = e == 0 ? it->plus[i] : it->minus[i];
+            str_cpy_fmt(&cmd, "setoption name %S value %I", options->spsaParam.tunables[i].name,
+                (intmax_t)llround(value));
+            engine_writeln(w, &engines[e], cmd.buf);
+        }
+}
+
+static void *thread_start(void *arg)
+{
+    Worker *w = arg;
+    Engine engines[2] = {0};
+
+    // Bind before starting engines, so that they inherit the affinity
+    if (options->numa)
+        numa_bind(w->node, w->id);
+
+    Job job[2] = {0};
+    int ei[2] = {-1, -1};  // eo[ei[0]] plays eo[ei[1]]: initialize with invalid values to start
+    size_t idx[2] = {0}, count = 0;  // game idx and count (shared across workers)
+
+    if (options->spsa) {
+        // SPSA: play pairs of games (same opening, colors reversed) with perturbed options, and
+        // update the tunables after each pair
+        scope(spsa_iteration_destroy) SPSAIteration it = spsa_iteration_init();
+
+        while (job_queue_pop_pair(&jq, job, idx, &count)) {
+            start_engines(w, engines, ei, &job[0]);
+            spsa_perturb(&spsa, &w->seed, &it);
+            spsa_send_options(w, engines, &it);
+
+            int result = 0;
+
+            for (int i = 0; i < 2; i++)
+                result += play_job(w, engines, ei, &job[i], idx[i], count) - RESULT_DRAW;
+
+            spsa_update(&spsa, &it, result);
+        }
+    } else
+        while (job_queue_pop(&jq, w->node, &job[0], &idx[0], &count)) {
+            start_engines(w, engines, ei, &job[0]);
+            play_job(w, engines, ei, &job[0], idx[0], count);
+        }
+
+    for (int i = 0; i < 2; i++)
+        engine_destroy(w, &engines[i]);
+
+    return NULL;
+}
+
+void match_start(void)
+// Start the adjudicator pool (if any), and one thread per worker playing games. Not before: the
+// balance pass of match_init() uses the workers playing games.
+{
+    if (options->adjudicatorParam.cmd.len)
+        adjudicator_start(&adjudicator);
+
+    threads = calloc((size_t)options->concurrency, sizeof(pthread_t));
+
+    for (int i = 0; i < options->concurrency; i++)
+        pthread_create(&threads[i], NULL, thread_start, &Workers[i]);
+}
+
+void match_monitor(void)
+// Check deadline overdue at regular intervals, until the job queue is done (and closed). Also print
+// memory reports, if requested.
+{
+    int64_t memReport = system_msec() + options->memStats * 1000;
+
+    do {
+        system_sleep(100);
+
+        if (options->memStats > 0 && system_msec() >= memReport) {
+            memstats_print(library ? stderr : stdout);
+            memReport += options->memStats * 1000;
+        }
+
+        // We want some tolerance on small delays here. Given a choice, it's best to wait for the
+        // worker thread to notice an overdue deadline, which it will handled nicely by counting the
+        // game as lost for the offending engine, and continue. Enforcing deadlines from the master
+        // thread is the last resort solution, because it is an unrecovrable error. At this point we
+        // are likely to face a completely unresponsive engine, where any attempt at I/O will block
+        // the master thread, on top of the already blocked worker. Hence, we must DIE().
+        for (size_t i = 0; i < vec_size(Workers); i++)
+            if (deadline_overdue(&Workers[i]) > 1000)
+                DIE("[%d] engine %s is unresponsive\n", Workers[i].id,
+                    Workers[i].deadline.engineName.buf);
+    } while (!job_queue_done(&jq));
+}
+
+void match_stop(void)
+// Discard the jobs not started yet, and close the job queue: workers return after their current game
+{
+    job_queue_stop(&jq);
+    job_queue_close(&jq);
+}
+
+void match_join(void)
+{
+    for (int i = 0; i < options->concurrency; i++)
+        pthread_join(threads[i], NULL);
+
+    if (options->adjudicatorParam.cmd.len)
+        adjudicator_destroy(&adjudicator);
+
+    if (PerfStats)
+        perf_print(jq.names, library ? stderr : stdout);
+}
+
+size_t match_submit(int rounds)
+// Library: play more rounds. Returns the number of games added.
+{
+    return job_queue_submit(&jq, rounds);
+}
+
+bool match_poll(CCCResult *r, bool wait)
+// Library: read the next result (in order of completion). If wait is set, block until a game is
+// played, unless all the games submitted so far were already read. Returns false if no result.
+{
+    pthread_mutex_lock(&output.mtx);
+
+    while (wait && output.resultsRead == vec_size(output.results)
+            && !job_queue_finished(&jq, output.played))
+        pthread_cond_wait(&output.cond, &output.mtx);
+
+    const bool ok = output.resultsRead < vec_size(output.results);
+
+    if (ok) {
+        *r = output.results[output.resultsRead++];
+
+        if (output.resultsRead == vec_size(output.results)) {
+            vec_clear(output.results);
+            output.resultsRead = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&output.mtx);
+    return ok;
+}
+
+size_t match_read_samples(char *buf, size_t size)
+// Library: read at most size bytes of samples (in the format of the sample file), as with read()
+{
+    pthread_mutex_lock(&output.mtx);
+
+    const size_t n = min(size, output.samples.len - output.samplesRead);
+    memcpy(buf, &output.samples.buf[output.samplesRead], n);
+    output.samplesRead += n;
+
+    if (output.samplesRead == output.samples.len) {
+        str_clear(&output.samples);
+        output.samplesRead = 0;
+    }
+
+    pthread_mutex_unlock(&output.mtx);
+    return n;
+}
@@ -0,0 +1,34 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "cccli.h"
+#include "options.h"
+
+// Match orchestration: job queue, worker threads playing games, and output writers. There is only one
+// match at a time (Workers[] is global). Used by the CLI, and by the library (see cccli.h), in which
+// case outputs are also buffered in memory, and the job queue stays open for more rounds.
+void match_init(Options *o, EngineOptions *eo, bool library);
+void match_destroy(void);
+
+void match_start(void);
+void match_monitor(void);
+void match_stop(void);
+void match_join(void);
+
+size_t match_submit(int rounds);
+bool match_poll(CCCResult *r, bool wait);
+size_t match_read_samples(char *buf, size_t size);
@@ -0,0 +1,75 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include "memstats.h"
+#include "str.h"
+#include "util.h"
+
+bool MemStats;
+
+static __thread int Tag;  // current subsystem of the calling thread
+
+// Updated concurrently by all threads, without locking
+static struct {
+    int64_t live, peak, allocs;
+} Stats[NB_MEM];
+
+int memstats_enter(int tag)
+{
+    const int prev = Tag;
+    Tag = tag;
+    return prev;
+}
+
+void memstats_leave(int *prev)
+{
+    Tag = *prev;
+}
+
+int memstats_tag(void)
+{
+    return Tag;
+}
+
+void memstats_update(int tag, int64_t bytes, bool alloc)
+// Account for a change of 'bytes' of subsystem 'tag', caused by an allocation (malloc or realloc) if
+// alloc is set, or a release otherwise
+{
+    const int64_t live = __atomic_add_fetch(&Stats[tag].live, bytes, __ATOMIC_RELAXED);
+    int64_t peak = __atomic_load_n(&Stats[tag].peak, __ATOMIC_RELAXED);
+
+    while (live > peak && !__atomic_compare_exchange_n(&Stats[tag].peak, &peak, live, true,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (alloc)
+        __atomic_add_fetch(&Stats[tag].allocs, 1, __ATOMIC_RELAXED);
+}
+
+void memstats_print(FILE *out)
+{
+    static const char *names[NB_MEM] = {"other", "games", "openings", "seqwriter", "samples",
+        "engine"};
+
+    scope(str_destroy) str_t report = str_init_from_c("Memory: subsystem, live bytes, peak bytes, "
+        "allocations\n");
+
+    for (int tag = 0; tag < NB_MEM; tag++)
+        str_cat_fmt(&report, "Memory: %s, %I, %I, %I\n", names[tag],
+            (intmax_t)__atomic_load_n(&Stats[tag].live, __ATOMIC_RELAXED),
+            (intmax_t)__atomic_load_n(&Stats[tag].peak, __ATOMIC_RELAXED),
+            (intmax_t)__atomic_load_n(&Stats[tag].allocs, __ATOMIC_RELAXED));
+
+    DIE_IF(0, fputs(report.buf, out) < 0);
+}
@@ -0,0 +1,43 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Memory accounting (-memstats): vec and str allocations are charged to the subsystem of the calling
+// thread when they are created (vec_init, first allocation of a str). Their growth and release are
+// charged to the same subsystem, wherever it happens. Those created while accounting is disabled are
+// never accounted.
+enum {
+    MEM_OTHER,
+    MEM_GAMES,  // games in progress (positions, moves, infos)
+    MEM_OPENINGS,  // openings index and stats
+    MEM_SEQWRITER,  // outputs waiting for previous games to complete (PGN backlog)
+    MEM_SAMPLES,  // samples (in games, and buffered by the library)
+    MEM_ENGINE,  // engine I/O (lines, names, options)
+    NB_MEM
+};
+
+extern bool MemStats;  // accounting is enabled
+
+// Enter a subsystem in the calling thread. Returns the previous one, to be restored by
+// memstats_leave() (eg. scope(memstats_leave) int memTag = memstats_enter(MEM_GAMES);)
+int memstats_enter(int tag);
+void memstats_leave(int *prev);
+int memstats_tag(void);
+
+void memstats_update(int tag, int64_t bytes, bool alloc);
+void memstats_print(FILE *out);
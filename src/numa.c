@@ -0,0 +1,101 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#ifdef __linux__
+    #define _GNU_SOURCE
+    #include <sched.h>
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "numa.h"
+#include "str.h"
+#include "util.h"
+#include "vec.h"
+
+#ifdef __linux__
+
+static cpu_set_t *NodeCpus;  // NodeCpus[node]: CPUs of each NUMA node
+
+static bool numa_parse_cpulist(const char *s, cpu_set_t *cpus)
+// Parse a cpulist, eg. "0-15,32-47"
+{
+    CPU_ZERO(cpus);
+    scope(str_destroy) str_t token = str_init();
+
+    while ((s = str_tok(s, &token, ",\n"))) {
+        int first = 0, last = 0;
+        const int n = sscanf(token.buf, "%d-%d", &first, &last);
+
+        if (n < 1 || first < 0)
+            return false;
+
+        for (int cpu = first; cpu <= (n == 2 ? last : first); cpu++)
+            CPU_SET((size_t)cpu, cpus);
+    }
+
+    return CPU_COUNT(cpus) > 0;
+}
+
+int numa_init(void)
+// Discover NUMA nodes from sysfs. Returns the number of nodes (1 if not available).
+{
+    NodeCpus = vec_init(cpu_set_t);
+    scope(str_destroy) str_t fileName = str_init(), line = str_init();
+
+    for (int node = 0; ; node++) {
+        str_cpy_fmt(&fileName, "/sys/devices/system/node/node%i/cpulist", node);
+        FILE *in = fopen(fileName.buf, "re");
+
+        if (!in)
+            break;
+
+        cpu_set_t cpus;
+        const bool ok = str_getline(&line, in) && numa_parse_cpulist(line.buf, &cpus);
+        DIE_IF(0, fclose(in) < 0);
+
+        if (!ok)
+            break;
+
+        vec_push(NodeCpus, cpus);
+    }
+
+    return vec_size(NodeCpus) ? (int)vec_size(NodeCpus) : 1;
+}
+
+void numa_destroy(void)
+{
+    vec_destroy(NodeCpus);
+}
+
+void numa_bind(int node, int threadId)
+// Bind the calling thread to the CPUs of 'node'. Engine processes started by this thread inherit
+// the affinity, and the kernel's first touch policy allocates their memory on the same node.
+{
+    if ((size_t)node < vec_size(NodeCpus)) {
+        // returns an error number, rather than setting errno
+        errno = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &NodeCpus[node]);
+        DIE_IF(threadId, errno);
+    }
+}
+
+#else
+
+int numa_init(void) { return 1; }
+void numa_destroy(void) {}
+void numa_bind(int node, int threadId) { (void)node; (void)threadId; }
+
+#endif
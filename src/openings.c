@@ -13,41 +13,136 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #include <assert.h>
+#include <string.h>
+#include "memstats.h"
 #include "openings.h"
+#include "position.h"
 #include "util.h"
 #include "vec.h"
 
-Openings openings_init(const char *fileName, bool random, uint64_t srand, int threadId)
+static OffsetIndex offset_index_init(void)
 {
+    return (OffsetIndex){
+        .bases = vec_init(uint64_t),
+        .deltas16 = vec_init(uint16_t)
+    };
+}
+
+static void offset_index_destroy(OffsetIndex *oi)
+{
+    vec_destroy(oi->bases);
+    vec_destroy(oi->deltas16);
+    vec_destroy(oi->deltas32);
+}
+
+static void offset_index_push(OffsetIndex *oi, uint64_t offset)
+// Offsets must be pushed in increasing order
+{
+    if (oi->size % OFFSET_BLOCK == 0)
+        vec_push(oi->bases, offset);
+
+    const uint64_t base = oi->bases[oi->size / OFFSET_BLOCK];
+    assert(offset >= base);
+    const uint64_t delta = offset - base;
+
+    if (oi->deltas16 && delta > UINT16_MAX) {
+        // Switch to 32-bit deltas
+        oi->deltas32 = vec_init_reserve(oi->size + 1, uint32_t);
+
+        for (size_t i = 0; i < oi->size; i++)
+            vec_push(oi->deltas32, oi->deltas16[i]);
+
+        vec_destroy(oi->deltas16);
+    }
+
+    if (oi->deltas16)
+        vec_push(oi->deltas16, (uint16_t)delta);
+    else if (delta <= UINT32_MAX)
+        vec_push(oi->deltas32, (uint32_t)delta);
+    else
+        DIE("openings: lines are too long\n");
+
+    oi->size++;
+}
+
+static uint64_t offset_index_get(const OffsetIndex *oi, size_t i)
+{
+    assert(i < oi->size);
+    return oi->bases[i / OFFSET_BLOCK] + (oi->deltas16 ? oi->deltas16[i] : oi->deltas32[i]);
+}
+
+// Returns the position in o->stats[] where 'key' is, or should be inserted
+static size_t openings_find_stats(const Openings *o, uint64_t key)
+{
+    size_t lo = 0, hi = vec_size(o->stats);
+
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (o->stats[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static OpeningStats *openings_get_stats(Openings *o, uint64_t key, bool insert)
+{
+    const size_t i = openings_find_stats(o, key);
+
+    if (i < vec_size(o->stats) && o->stats[i].key == key)
+        return &o->stats[i];
+    else if (!insert)
+        return NULL;
+
+    // Insert new element in position i
+    const size_t n = vec_size(o->stats);
+    vec_push(o->stats, (OpeningStats){.key = key});
+    memmove(&o->stats[i + 1], &o->stats[i], (n - i) * sizeof(OpeningStats));
+    o->stats[i] = (OpeningStats){.key = key};
+
+    return &o->stats[i];
+}
+
+Openings openings_init(const char *fileName, int threadId)
+{
+    scope(memstats_leave) int memTag = memstats_enter(MEM_OPENINGS);
     Openings o = {0};
-    o.index = vec_init(size_t);
+    o.index = offset_index_init();
+    o.stats = vec_init(OpeningStats);
 
     if (*fileName)
         DIE_IF(threadId, !(o.file = fopen(fileName, "re")));
 
     if (o.file) {
-        // Fill o.index[] to record file offsets for each lines
+        // Fill o.index to record file offsets for each lines
         scope(str_destroy) str_t line = str_init();
+        long offset = ftell(o.file);
 
-        do {
-            vec_push(o.index, ftell(o.file));
-        } while (str_getline(&line, o.file));
+        while (str_getline(&line, o.file)) {
+            offset_index_push(&o.index, (uint64_t)offset);
+            offset = ftell(o.file);
+        }
+    }
 
-        vec_pop(o.index);  // EOF offset must be removed
+    pthread_mutex_init(&o.mtx, NULL);
+    return o;
+}
 
-        if (random) {
-            // Shuffle o.index[], which will be read sequentially from the beginning. This allows
-            // consistent treatment of random and !random, and guarantees no repetition N-cycles in
-            // the random case, rather than sqrt(N) (birthday paradox) if random seek each time.
-            const size_t n = vec_size(o.index);
-            uint64_t seed = srand ? srand : (uint64_t)system_msec();
+Openings openings_share(const Openings *owner, const char *fileName, int threadId)
+// Another handle on the book of 'owner', with its own file and lock (eg. one per NUMA node), so that
+// readers do not contend. The index and order of 'owner' are shared (read only): its order must be
+// set before, and the returned handle must not be used after 'owner' is destroyed. Stats are not
+// shared: record results with 'owner'.
+{
+    Openings o = *owner;
+    o.stats = NULL;
+    o.shared = true;
 
-            for (size_t i = n - 1; i > 0; i--) {
-                const size_t j = prng(&seed) % (i + 1);
-                swap(o.index[i], o.index[j]);
-            }
-        }
-    }
+    if (owner->file)
+        DIE_IF(threadId, !(o.file = fopen(fileName, "re")));
 
     pthread_mutex_init(&o.mtx, NULL);
     return o;
@@ -59,23 +154,295 @@ void openings_destroy(Openings *o, int threadId)
         DIE_IF(threadId, fclose(o->file) < 0);
 
     pthread_mutex_destroy(&o->mtx);
-    vec_destroy(o->index);
+
+    if (o->shared)
+        return;
+
+    offset_index_destroy(&o->index);
+    vec_destroy(o->stats);
+    vec_destroy(o->prob);
+    vec_destroy(o->alias);
 }
 
-void openings_next(Openings *o, str_t *fen, size_t idx, int threadId)
+size_t openings_count(const Openings *o)
 {
-    if (!o->file) {
-        str_cpy_c(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
-        return;
+    return o->file ? o->index.size : 1;
+}
+
+// Remove the openings for which keep[i] is false, preserving the order of the remaining ones.
+void openings_filter(Openings *o, const bool *keep)
+{
+    OffsetIndex filtered = offset_index_init();
+
+    for (size_t i = 0; i < o->index.size; i++)
+        if (keep[i])
+            offset_index_push(&filtered, offset_index_get(&o->index, i));
+
+    offset_index_destroy(&o->index);
+    o->index = filtered;
+}
+
+static uint64_t openings_feistel(uint64_t x, int halfBits, uint64_t key)
+// Balanced Feistel network on 2*halfBits bits: a keyed bijection of [0, 2^(2*halfBits)).
+{
+    const uint64_t mask = (1ULL << halfBits) - 1;
+    uint64_t left = x >> halfBits, right = x & mask;
+
+    for (uint64_t round = 0; round < 4; round++) {
+        uint64_t state = key ^ (right + (round << 32));
+        const uint64_t f = prng(&state) & mask;
+        const uint64_t tmp = right;
+        right = left ^ f;
+        left = tmp;
     }
 
-    // Read 'fen' from file
+    return left << halfBits | right;
+}
+
+static size_t openings_permute(size_t idx, size_t n, uint64_t key)
+// Keyed pseudo-random permutation of [0, n). The Feistel domain is the smallest even power of 2
+// that is >= n, hence < 4n. Cycle walking (apply again until we fall in range) yields a permutation
+// of [0, n), with an expected number of iterations < 4.
+{
+    assert(idx < n);
+
+    if (n < 2)
+        return idx;
+
+    const int bits = 64 - __builtin_clzll((unsigned long long)(n - 1));
+    const int halfBits = (bits + 1) / 2;
+    uint64_t x = idx;
+
+    do {
+        x = openings_feistel(x, halfBits, key);
+    } while (x >= n);
+
+    return (size_t)x;
+}
+
+void openings_random(Openings *o, uint64_t srand)
+// Switch to random order. Rather than shuffling o->index upfront, openings_next() maps idx to a
+// keyed permutation of the index, computed in O(1). This guarantees no repetition N-cycles, rather
+// than sqrt(N) (birthday paradox) if we were to draw random openings independently each time.
+{
+    o->random = true;
+    o->seed = srand ? srand : (uint64_t)system_msec();
+}
+
+static void openings_read_line(Openings *o, str_t *line, size_t idx, int threadId)
+{
+    pthread_mutex_lock(&o->mtx);
+    const long offset = (long)offset_index_get(&o->index, idx % o->index.size);
+    const bool ok = fseek(o->file, offset, SEEK_SET) >= 0 && str_getline(line, o->file);
+    pthread_mutex_unlock(&o->mtx);
+
+    // Die without holding the lock: exit() saves the stats (main_destroy), which takes it again
+    DIE_IF(threadId, !ok);
+}
+
+uint64_t openings_hash(Openings *o, int threadId)
+// FNV-1a hash of the lines of the book (in file order), to detect when a cache built from it (eg.
+// balance scores) is stale.
+{
     scope(str_destroy) str_t line = str_init();
+    uint64_t h = 0xcbf29ce484222325;
 
+    for (size_t i = 0; i < o->index.size; i++) {
+        openings_read_line(o, &line, i, threadId);
+
+        for (size_t j = 0; j <= line.len; j++)  // include '\0' to separate lines
+            h = (h ^ (unsigned char)line.buf[j]) * 0x100000001b3;
+    }
+
+    return h;
+}
+
+static double openings_weight_opcode(const char *line)
+// Parse the weight from the EPD opcode 'weight W', if any. Default weight is 1.
+{
+    strv_t token;  // view of line
+    const char *tail = strv_tok(line, &token, ";");  // skip FEN
+
+    while ((tail = strv_tok(tail, &token, ";"))) {
+        const size_t spaces = strspn(token.buf, " ");  // stops at the end of the token (';')
+        const strv_t opcode = {.buf = token.buf + spaces, .len = token.len - spaces};
+
+        if (opcode.len >= 7 && !strncmp(opcode.buf, "weight ", 7))
+            return strv_to_double((strv_t){.buf = opcode.buf + 7, .len = opcode.len - 7});
+    }
+
+    return 1;
+}
+
+static double openings_weight_informative(const Openings *o, const char *line, int threadId)
+// The weight of an opening is the variance of game results (from white's pov), using a prior of
+// one win, one draw, and one loss. Dead draws, and openings where the same side always wins, tend
+// to zero variance (they do not discriminate between engines), while unplayed openings get the
+// prior variance 1/6.
+{
+    scope(str_destroy) str_t fen = str_init();
+    str_tok(line, &fen, ";");
+    Position pos;
+
+    if (!pos_set(&pos, fen.buf, false, NULL))
+        DIE("[%d] illegal FEN '%s'\n", threadId, fen.buf);
+
+    const size_t i = openings_find_stats(o, pos.key);
+    const OpeningStats *os = i < vec_size(o->stats) && o->stats[i].key == pos.key
+        ? &o->stats[i] : NULL;
+
+    const double l = 1 + (os ? os->count[0] : 0), d = 1 + (os ? os->count[1] : 0),
+        w = 1 + (os ? os->count[2] : 0);
+    const double mean = (w + d / 2) / (w + d + l);
+
+    return (w + d / 4) / (w + d + l) - mean * mean;
+}
+
+static void openings_build_alias(Openings *o, double *w, int threadId)
+// Walker's alias method (Vose's variant), so that openings_next() can draw an opening with
+// probability proportional to its weight in O(1). Note that w[] is used as scratch space.
+{
+    const size_t n = o->index.size;
+    double sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (w[i] < 0)
+            DIE("[%d] negative opening weight %f\n", threadId, w[i]);
+
+        sum += w[i];
+    }
+
+    if (sum <= 0)
+        DIE("[%d] opening weights sum to zero\n", threadId);
+
+    o->prob = vec_init_reserve(n, double);
+    o->alias = vec_init_reserve(n, size_t);
+    size_t *small = vec_init(size_t), *large = vec_init(size_t);
+
+    for (size_t i = 0; i < n; i++) {
+        vec_push(o->prob, 1.0);
+        vec_push(o->alias, i);
+
+        w[i] *= (double)n / sum;
+
+        if (w[i] < 1)
+            vec_push(small, i);
+        else
+            vec_push(large, i);
+    }
+
+    while (vec_size(small) && vec_size(large)) {
+        const size_t s = vec_pop(small), l = vec_pop(large);
+        o->prob[s] = w[s];
+        o->alias[s] = l;
+        w[l] -= 1 - w[s];
+
+        if (w[l] < 1)
+            vec_push(small, l);
+        else
+            vec_push(large, l);
+    }
+
+    // Leftovers (from either list, due to rounding errors) keep prob=1 and alias=self
+
+    vec_destroy(small);
+    vec_destroy(large);
+}
+
+void openings_weighted(Openings *o, bool informative, uint64_t srand, int threadId)
+// Switch to weighted random order: weights are either parsed from the 'weight' EPD opcode, or
+// calculated from the history of outcomes (informative).
+{
+    scope(memstats_leave) int memTag = memstats_enter(MEM_OPENINGS);
+    const size_t n = o->index.size;
+    double *weights = calloc(n, sizeof(double));
+    scope(str_destroy) str_t line = str_init();
+
+    for (size_t i = 0; i < n; i++) {
+        openings_read_line(o, &line, i, threadId);
+        weights[i] = informative ? openings_weight_informative(o, line.buf, threadId)
+            : openings_weight_opcode(line.buf);
+    }
+
+    if (n)
+        openings_build_alias(o, weights, threadId);
+
+    o->seed = srand ? srand : (uint64_t)system_msec();
+    free(weights);
+}
+
+void openings_load_stats(Openings *o, const char *fileName)
+{
+    FILE *in = fopen(fileName, "re");
+
+    if (!in)
+        return;  // no history yet
+
+    scope(str_destroy) str_t line = str_init();
+
+    while (str_getline(&line, in)) {
+        uint64_t key = 0;
+        int count[3] = {0};
+
+        if (sscanf(line.buf, "%" SCNx64 " %d %d %d", &key, &count[0], &count[1], &count[2]) != 4)
+            DIE("Illegal line in '%s': '%s'\n", fileName, line.buf);
+
+        OpeningStats *os = openings_get_stats(o, key, true);
+
+        for (int i = 0; i < 3; i++)
+            os->count[i] += count[i];
+    }
+
+    DIE_IF(0, fclose(in) < 0);
+}
+
+void openings_save_stats(Openings *o, const char *fileName)
+{
+    FILE *out = fopen(fileName, "we");
+    DIE_IF(0, !out);
+
+    pthread_mutex_lock(&o->mtx);
+    bool ok = true;
+
+    for (size_t i = 0; ok && i < vec_size(o->stats); i++)
+        ok = fprintf(out, "%016" PRIx64 " %d %d %d\n", o->stats[i].key, o->stats[i].count[0],
+            o->stats[i].count[1], o->stats[i].count[2]) >= 0;
+
+    pthread_mutex_unlock(&o->mtx);
+    DIE_IF(0, !ok);  // see openings_read_line()
+    DIE_IF(0, fclose(out) < 0);
+}
+
+void openings_add_result(Openings *o, uint64_t key, int wpov)
+{
     pthread_mutex_lock(&o->mtx);
-    DIE_IF(threadId, fseek(o->file, o->index[idx % vec_size(o->index)], SEEK_SET) < 0);
-    DIE_IF(threadId, !str_getline(&line, o->file));
+    openings_get_stats(o, key, true)->count[wpov]++;
     pthread_mutex_unlock(&o->mtx);
+}
+
+size_t openings_next(Openings *o, str_t *fen, size_t idx, int threadId)
+// Returns the line number of the opening in the book (0 if there is no book)
+{
+    if (!o->file) {
+        str_cpy_c(fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+        return 0;
+    }
+
+    if (o->random) {
+        const size_t n = o->index.size;
+        idx = openings_permute(idx % n, n, o->seed);
+    } else if (o->prob) {
+        // Weighted random draw: the random state only depends on idx, so that the sequence is
+        // reproducible regardless of the order in which workers call openings_next().
+        uint64_t state = o->seed + 2 * idx * 0x9E3779B97F4A7C15;
+        const size_t i = prng(&state) % vec_size(o->prob);
+        idx = prngf(&state) < o->prob[i] ? i : o->alias[i];
+    }
+
+    // Read 'fen' from file
+    scope(str_destroy) str_t line = str_init();
+    openings_read_line(o, &line, idx, threadId);
 
     str_tok(line.buf, fen, ";");
+    return idx % o->index.size;
 }
@@ -19,13 +19,58 @@
 #include <stdio.h>
 #include "str.h"
 
+enum {
+    ORDER_SEQUENTIAL,
+    ORDER_RANDOM,
+    ORDER_WEIGHTED,
+    ORDER_INFORMATIVE
+};
+
+// Historical outcomes of games played from an opening (identified by its position key). Counts are
+// from white's point of view, indexed by RESULT_LOSS/DRAW/WIN.
+typedef struct {
+    uint64_t key;
+    int count[3];
+    char pad[4];
+} OpeningStats;
+
+// Compact index of (increasing) file offsets: a 64-bit base every OFFSET_BLOCK lines, and a 16-bit
+// delta per line, relative to its block base. If lines are too long for 16-bit deltas, we switch to
+// 32-bit deltas (still half the size of storing offsets).
+enum {OFFSET_BLOCK = 256};
+
+typedef struct {
+    uint64_t *bases;  // vector of block bases
+    uint16_t *deltas16;  // vector of deltas (NULL if using deltas32)
+    uint32_t *deltas32;  // vector of deltas (NULL if using deltas16)
+    size_t size;  // number of offsets
+} OffsetIndex;
+
 typedef struct {
     pthread_mutex_t mtx;
     FILE *file;
-    long *index;  // vector of file offsets
+    OffsetIndex index;  // file offsets of each line
+    OpeningStats *stats;  // vector sorted by key
+    double *prob;  // alias table for weighted order: probability of keeping the drawn index
+    size_t *alias;  // alias table for weighted order: index to use instead
+    uint64_t seed;  // seed for random and weighted orders
+    bool random;
+    bool shared;  // borrows the index and order of another handle (see openings_share)
+    char pad[6];
 } Openings;
 
-Openings openings_init(const char *fileName, bool random, uint64_t srand, int threadId);
+Openings openings_init(const char *fileName, int threadId);
+Openings openings_share(const Openings *owner, const char *fileName, int threadId);
 void openings_destroy(Openings *openings, int threadId);
 
-void openings_next(Openings *o, str_t *fen, size_t idx, int threadId);
+size_t openings_count(const Openings *o);
+uint64_t openings_hash(Openings *o, int threadId);
+void openings_filter(Openings *o, const bool *keep);
+void openings_random(Openings *o, uint64_t srand);
+void openings_weighted(Openings *o, bool informative, uint64_t srand, int threadId);
+
+void openings_load_stats(Openings *o, const char *fileName);
+void openings_save_stats(Openings *o, const char *fileName);
+void openings_add_result(Openings *o, uint64_t key, int wpov);
+
+size_t openings_next(Openings *o, str_t *fen, size_t idx, int threadId);
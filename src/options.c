@@ -15,23 +15,51 @@
 #include <assert.h>
 #include <ctype.h>
 #include <limits.h>
+#include <setjmp.h>
+#include <stdio.h>
 #include <string.h>
+#include "jobs.h"
 #include "options.h"
 #include "util.h"
 #include "vec.h"
 
+// Invalid options are fatal in the program, but returned to the caller of options_try_parse() in the
+// library: FAIL() then writes the message in Fail.buf, and jumps back there.
+static struct {
+    jmp_buf *env;
+    char *buf;
+    size_t size;
+} Fail;
+
+#define FAIL(...) do { \
+    if (Fail.env) { \
+        snprintf(Fail.buf, Fail.size, __VA_ARGS__); \
+        longjmp(*Fail.env, 1); \
+    } \
+    DIE(__VA_ARGS__); \
+} while (0)
+
+static const char *options_value(int argc, const char **argv, int i)
+// Value of the option argv[i - 1]
+{
+    if (i >= argc)
+        FAIL("Missing value for '%s'\n", argv[i - 1]);
+
+    return argv[i];
+}
+
 static void options_parse_sample(const char *s, Options *o)
 {
+    // Parse sample frequency (and check range), before allocating anything that FAIL() would leak
+    o->sampleFrequency = atof(s);  // stops at the first ','
+
+    if (o->sampleFrequency > 1.0 || o->sampleFrequency < 0.0)
+        FAIL("Sample frequency '%f' must be between 0 and 1\n", o->sampleFrequency);
+
     scope(str_destroy) str_t token = str_init();
     const char *tail = str_tok(s, &token, ",");
     assert(tail);
 
-    // Parse sample frequency (and check range)
-    o->sampleFrequency = atof(token.buf);
-
-    if (o->sampleFrequency > 1.0 || o->sampleFrequency < 0.0)
-        DIE("Sample frequency '%f' must be between 0 and 1\n", o->sampleFrequency);
-
     // Parse resolve flag
     if ((tail = str_tok(tail, &token, ",")))
         o->sampleResolvePv = !strcmp(token.buf, "y");
@@ -41,6 +69,10 @@ static void options_parse_sample(const char *s, Options *o)
         str_cpy(&o->sample, token);
     else
         str_cpy_c(&o->sample, "sample.csv");
+
+    // Parse multipv flag
+    if ((tail = str_tok(tail, &token, ",")))
+        o->sampleMultiPv = !strcmp(token.buf, "y");
 }
 
 // Parse time control. Expects 'mtg/time+inc' or 'time+inc'. Note that time and inc are provided by
@@ -89,7 +121,7 @@ static int options_parse_eo(int argc, const char **argv, int i, EngineOptions *e
         else if ((tail = str_prefix(argv[i], "tc=")))
             options_parse_tc(tail, eo);
         else
-            DIE("Illegal syntax '%s'\n", argv[i]);
+            FAIL("Illegal syntax '%s'\n", argv[i]);
 
         i++;
     }
@@ -106,13 +138,19 @@ static int options_parse_openings(int argc, const char **argv, int i, Options *o
             str_cpy_c(&o->openings, tail);
         else if ((tail = str_prefix(argv[i], "order="))) {
             if (!strcmp(tail, "random"))
-                o->random = true;
+                o->order = ORDER_RANDOM;
+            else if (!strcmp(tail, "weighted"))
+                o->order = ORDER_WEIGHTED;
+            else if (!strcmp(tail, "informative"))
+                o->order = ORDER_INFORMATIVE;
             else if (strcmp(tail, "sequential"))
-                DIE("Invalid order for -openings: '%s'\n", tail);
+                FAIL("Invalid order for -openings: '%s'\n", tail);
         } else if ((tail = str_prefix(argv[i], "srand=")))
             o->srand = (uint64_t)atoll(tail);
+        else if ((tail = str_prefix(argv[i], "stats=")))
+            str_cpy_c(&o->openingStats, tail);
         else
-            DIE("Illegal token in -openings: '%s'\n", argv[i]);
+            FAIL("Illegal token in -openings: '%s'\n", argv[i]);
 
         i++;
     }
@@ -126,7 +164,7 @@ static int options_parse_adjudication(int argc, const char **argv, int i, int *c
         *count = atoi(argv[i++]);
         *score = atoi(argv[i]);
     } else
-        DIE("Missing parameter(s) for '%s'\n", argv[i - 1]);
+        FAIL("Missing parameter(s) for '%s'\n", argv[i - 1]);
 
     return i;
 }
@@ -147,13 +185,288 @@ static int options_parse_sprt(int argc, const char **argv, int i, Options *o)
         else if ((tail = str_prefix(argv[i], "beta=")))
             o->sprtParam.beta = atof(tail);
         else
-            DIE("Illegal token in -sprt: '%s'\n", argv[i]);
+            FAIL("Illegal token in -sprt: '%s'\n", argv[i]);
 
         i++;
     }
 
     if (!sprt_validate(&o->sprtParam))
-        DIE("Invalid SPRT parameters\n");
+        FAIL("Invalid SPRT parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_sprtsim(int argc, const char **argv, int i, Options *o)
+{
+    o->sprtSim = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "elo=")))
+            o->sprtSimParam.elo = atof(tail);
+        else if ((tail = str_prefix(argv[i], "draw=")))
+            o->sprtSimParam.draw = atof(tail);
+        else if ((tail = str_prefix(argv[i], "runs=")))
+            o->sprtSimParam.runs = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "maxgames=")))
+            o->sprtSimParam.maxGames = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "srand=")))
+            o->sprtSimParam.srand = (uint64_t)atoll(tail);
+        else
+            FAIL("Illegal token in -sprtsim: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (!sprt_sim_validate(&o->sprtSimParam))
+        FAIL("Invalid SPRT simulation parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_query(int argc, const char **argv, int i, Options *o)
+{
+    str_cpy_c(&o->query.file, argv[i++]);
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "idx=")))
+            o->query.idx = atoll(tail) - 1;
+        else if ((tail = str_prefix(argv[i], "opening=")))
+            o->query.opening = atoll(tail) - 1;
+        else if ((tail = str_prefix(argv[i], "engine=")))
+            str_cpy_c(&o->query.engine, tail);
+        else if ((tail = str_prefix(argv[i], "result=")))
+            str_cpy_c(&o->query.result, tail);
+        else if ((tail = str_prefix(argv[i], "reason=")))
+            str_cpy_c(&o->query.reason, tail);
+        else if ((tail = str_prefix(argv[i], "pgn=")))
+            str_cpy_c(&o->query.pgn, tail);
+        else
+            FAIL("Illegal token in -query: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    return i - 1;
+}
+
+static int options_parse_serve(int argc, const char **argv, int i, Options *o)
+{
+    ServeParam *sp = &o->serveParam;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "port=")))
+            sp->port = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "cmd=")))
+            str_cpy_c(&sp->cmd, tail);
+        else if ((tail = str_prefix(argv[i], "bind=")))
+            str_cpy_c(&sp->address, tail);
+        else
+            FAIL("Illegal token in -serve: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (sp->port <= 0 || sp->port > 65535 || !sp->cmd.len)
+        FAIL("-serve requires port=PORT and cmd=COMMAND\n");
+
+    return i - 1;
+}
+
+static int options_parse_adjudicator(int argc, const char **argv, int i, Options *o)
+{
+    AdjudicatorParam *ap = &o->adjudicatorParam;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "cmd=")))
+            str_cpy_c(&ap->cmd, tail);
+        else if ((tail = str_prefix(argv[i], "option.")))
+            vec_push(ap->options, str_init_from_c(tail));  // store "name=value" string
+        else if ((tail = str_prefix(argv[i], "nodes=")))
+            ap->nodes = atoll(tail);
+        else if ((tail = str_prefix(argv[i], "timeout=")))
+            ap->timeout = atoll(tail);
+        else if ((tail = str_prefix(argv[i], "pool=")))
+            ap->pool = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "every=")))
+            ap->every = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "count=")))
+            ap->count = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "resign=")))
+            ap->resignScore = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "draw=")))
+            ap->drawScore = atoi(tail);
+        else
+            FAIL("Illegal token in -adjudicator: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (!ap->cmd.len || ap->nodes <= 0 || ap->timeout <= 0 || ap->pool <= 0 || ap->every <= 0
+            || ap->count <= 0 || ap->resignScore < 0 || ap->drawScore < 0)
+        FAIL("Invalid adjudicator parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_adjsim(int argc, const char **argv, int i, Options *o)
+{
+    str_cpy_c(&o->adjSimParam.pgn, argv[i++]);
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+        AdjRule r = {0};
+
+        if ((tail = str_prefix(argv[i], "resign=")) && adjsim_parse_rule(tail, &r))
+            vec_push(o->adjSimParam.resign, r);
+        else if ((tail = str_prefix(argv[i], "draw=")) && adjsim_parse_rule(tail, &r))
+            vec_push(o->adjSimParam.draw, r);
+        else
+            FAIL("Illegal token in -adjsim: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (!vec_size(o->adjSimParam.resign) && !vec_size(o->adjSimParam.draw))
+        FAIL("-adjsim needs at least one resign or draw rule\n");
+
+    return i - 1;
+}
+
+static int options_parse_balance(int argc, const char **argv, int i, Options *o)
+{
+    o->balance = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "engine=")))
+            o->balanceParam.engine = atoi(tail) - 1;
+        else if ((tail = str_prefix(argv[i], "nodes=")))
+            o->balanceParam.nodes = atoll(tail);
+        else if ((tail = str_prefix(argv[i], "min=")))
+            o->balanceParam.min = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "max=")))
+            o->balanceParam.max = atoi(tail);
+        else
+            FAIL("Illegal token in -balance: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o->balanceParam.nodes <= 0 || o->balanceParam.min > o->balanceParam.max)
+        FAIL("Invalid balance parameters\n");
+
+    return i - 1;
+}
+
+static void options_parse_rate(const char *s, SamplePolicy *sp, int phase)
+{
+    const double rate = atof(s);
+
+    if (rate > 1.0 || rate < 0.0)
+        FAIL("Sample frequency '%f' must be between 0 and 1\n", rate);
+
+    sp->rate[phase] = rate;
+    sp->rateSet[phase] = true;
+}
+
+static int options_parse_samplepolicy(int argc, const char **argv, int i, Options *o)
+{
+    SamplePolicy *sp = &o->samplePolicy;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "minply=")))
+            sp->minPly = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "maxply=")))
+            sp->maxPly = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "maxscore=")))
+            sp->maxScore = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "skipend=")))
+            sp->skipEnd = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "max=")))
+            sp->maxPerGame = atoi(tail);
+        else if ((tail = str_prefix(argv[i], "opening=")))
+            options_parse_rate(tail, sp, PHASE_OPENING);
+        else if ((tail = str_prefix(argv[i], "middlegame=")))
+            options_parse_rate(tail, sp, PHASE_MIDDLEGAME);
+        else if ((tail = str_prefix(argv[i], "endgame=")))
+            options_parse_rate(tail, sp, PHASE_ENDGAME);
+        else
+            FAIL("Illegal token in -samplepolicy: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (sp->minPly < 0 || sp->maxPly < sp->minPly || sp->maxScore < 0 || sp->skipEnd < 0
+            || sp->maxPerGame < 0)
+        FAIL("Invalid sample policy\n");
+
+    return i - 1;
+}
+
+static int options_parse_race(int argc, const char **argv, int i, Options *o)
+{
+    o->tournament = TOURNAMENT_RACE;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if (!strcmp(argv[i], "reference"))
+            o->raceParam.reference = true;
+        else if ((tail = str_prefix(argv[i], "z=")))
+            o->raceParam.z = atof(tail);
+        else
+            FAIL("Illegal token in -race: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (o->raceParam.z < 0)
+        FAIL("Invalid race parameters\n");
+
+    return i - 1;
+}
+
+static int options_parse_spsa(int argc, const char **argv, int i, Options *o)
+{
+    o->spsa = true;
+
+    while (i < argc && argv[i][0] != '-') {
+        const char *tail = NULL;
+
+        if ((tail = str_prefix(argv[i], "alpha=")))
+            o->spsaParam.alpha = atof(tail);
+        else if ((tail = str_prefix(argv[i], "gamma=")))
+            o->spsaParam.gamma = atof(tail);
+        else if ((tail = str_prefix(argv[i], "A=")))
+            o->spsaParam.A = atof(tail);
+        else if ((tail = str_prefix(argv[i], "param."))) {
+            SPSATunable t = {.name = str_init()};
+
+            if (!spsa_parse_tunable(tail, &t)) {
+                str_destroy(&t.name);
+                FAIL("Invalid SPSA parameter '%s'\n", tail);
+            }
+
+            vec_push(o->spsaParam.tunables, t);  // t gets moved here
+        } else
+            FAIL("Illegal token in -spsa: '%s'\n", argv[i]);
+
+        i++;
+    }
+
+    if (!vec_size(o->spsaParam.tunables))
+        FAIL("No parameter to tune in -spsa\n");
 
     return i - 1;
 }
@@ -173,51 +486,97 @@ void engine_options_destroy(EngineOptions *eo)
     vec_destroy_rec(eo->options, str_destroy);
 }
 
+bool engine_options_same_process(const EngineOptions *a, const EngineOptions *b)
+// Can a and b be played by the same engine process? Only cmd and options matter (those are sent at
+// startup), not the name or search limits (sent with each go command).
+{
+    if (!str_eq(a->cmd, b->cmd) || vec_size(a->options) != vec_size(b->options))
+        return false;
+
+    for (size_t i = 0; i < vec_size(a->options); i++)
+        if (!str_eq(a->options[i], b->options[i]))
+            return false;
+
+    return true;
+}
+
 Options options_init(void)
 {
     Options o = {0};
     o.openings = str_init();
+    o.openingStats = str_init();
     o.pgn = str_init();
     o.sample = str_init();
+    o.gamedb = str_init();
+    o.results = str_init();
+    o.merge = vec_init(str_t);
+    o.query = gamedb_query_init();
+    o.adjSimParam = adjsim_param_init();
+    o.adjudicatorParam = adjudicator_param_init();
+    o.serveParam.cmd = str_init();
+    o.serveParam.address = str_init_from_c("127.0.0.1");
 
     // non-zero default values
     o.concurrency = 1;
     o.games = o.rounds = 1;
     o.sprtParam.alpha = o.sprtParam.beta = 0.05;
     o.pgnVerbosity = 3;
+    o.memStats = -1;
+    o.balanceParam.nodes = 100000;
+    o.balanceParam.min = -150;
+    o.balanceParam.max = 150;
+    o.spsaParam.tunables = vec_init(SPSATunable);
+    o.spsaParam.alpha = 0.602;
+    o.spsaParam.gamma = 0.101;
+    o.raceParam.z = 1;
+    o.sprtSimParam.draw = 0.5;
+    o.sprtSimParam.runs = 1000;
+    o.sprtSimParam.maxGames = 1000000;
+    o.samplePolicy.maxPly = o.samplePolicy.maxScore = INT_MAX;
 
     return o;
 }
 
-void options_parse(int argc, const char **argv, Options *o, EngineOptions **eo)
+static void do_options_parse(int argc, const char **argv, Options *o, EngineOptions **eo,
+    EngineOptions *each)
 {
-    scope(engine_options_destroy) EngineOptions each = engine_options_init();
     bool eachSet = false;
 
     for (int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "-repeat"))
             o->repeat = true;
         else if (!strcmp(argv[i], "-gauntlet"))
-            o->gauntlet = true;
+            o->tournament = TOURNAMENT_GAUNTLET;
+        else if (!strcmp(argv[i], "-swiss"))
+            o->tournament = TOURNAMENT_SWISS;
+        else if (!strcmp(argv[i], "-race"))
+            i = options_parse_race(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-numa"))
+            o->numa = true;
+        else if (!strcmp(argv[i], "-perf"))
+            o->perf = true;
+        else if (!strcmp(argv[i], "-selfplay"))
+            o->selfPlay = true;
         else if (!strcmp(argv[i], "-log"))
             o->log = true;
+        else if (!strcmp(argv[i], "-memstats"))
+            o->memStats = atoi(options_value(argc, argv, ++i));
         else if (!strcmp(argv[i], "-concurrency"))
-            o->concurrency = atoi(argv[++i]);
+            o->concurrency = atoi(options_value(argc, argv, ++i));
         else if (!strcmp(argv[i], "-each")) {
-            i = options_parse_eo(argc, argv, i + 1, &each);
+            i = options_parse_eo(argc, argv, i + 1, each);
             eachSet = true;
         } else if (!strcmp(argv[i], "-engine")) {
-            EngineOptions new = engine_options_init();
-            i = options_parse_eo(argc, argv, i + 1, &new);
-            vec_push(*eo, new);  // new gets moved here
+            vec_push(*eo, engine_options_init());  // owned by *eo, even if FAIL() jumps out
+            i = options_parse_eo(argc, argv, i + 1, &(*eo)[vec_size(*eo) - 1]);
         } else if (!strcmp(argv[i], "-games"))
-            o->games = atoi(argv[++i]);
+            o->games = atoi(options_value(argc, argv, ++i));
         else if (!strcmp(argv[i], "-rounds"))
-            o->rounds = atoi(argv[++i]);
+            o->rounds = atoi(options_value(argc, argv, ++i));
         else if (!strcmp(argv[i], "-openings"))
             i = options_parse_openings(argc, argv, i + 1, o);
         else if (!strcmp(argv[i], "-pgn")) {
-            str_cpy_c(&o->pgn, argv[++i]);
+            str_cpy_c(&o->pgn, options_value(argc, argv, ++i));
 
             if (i + 1 < argc && argv[i + 1][0] != '-')
                 o->pgnVerbosity = atoi(argv[++i]);
@@ -227,51 +586,152 @@ void options_parse(int argc, const char **argv, Options *o, EngineOptions **eo)
             i = options_parse_adjudication(argc, argv, i + 1, &o->drawCount, &o->drawScore);
         else if (!strcmp(argv[i], "-sprt"))
             i = options_parse_sprt(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-pgnindex"))
+            o->pgnIndex = true;
+        else if (!strcmp(argv[i], "-results"))
+            str_cpy_c(&o->results, options_value(argc, argv, ++i));
+        else if (!strcmp(argv[i], "-merge")) {
+            while (i + 1 < argc && argv[i + 1][0] != '-')
+                vec_push(o->merge, str_init_from_c(argv[++i]));
+        } else if (!strcmp(argv[i], "-gamedb"))
+            str_cpy_c(&o->gamedb, options_value(argc, argv, ++i));
+        else if (!strcmp(argv[i], "-query"))
+            i = options_parse_query(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-serve"))
+            i = options_parse_serve(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-adjudicator"))
+            i = options_parse_adjudicator(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-adjsim"))
+            i = options_parse_adjsim(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-sprtsim"))
+            i = options_parse_sprtsim(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-spsa"))
+            i = options_parse_spsa(argc, argv, i + 1, o);
+        else if (!strcmp(argv[i], "-balance"))
+            i = options_parse_balance(argc, argv, i + 1, o);
         else if (!strcmp(argv[i], "-sample"))
-            options_parse_sample(argv[++i], o);
+            options_parse_sample(options_value(argc, argv, ++i), o);
+        else if (!strcmp(argv[i], "-samplepolicy"))
+            i = options_parse_samplepolicy(argc, argv, i + 1, o);
         else
-            DIE("Unknown option '%s'\n", argv[i]);
+            FAIL("Unknown option '%s'\n", argv[i]);
     }
 
     if (eachSet) {
         for (size_t i = 0; i < vec_size(*eo); i++) {
-            if (each.cmd.len)
-                str_cpy(&(*eo)[i].cmd, each.cmd);
+            if (each->cmd.len)
+                str_cpy(&(*eo)[i].cmd, each->cmd);
 
-            if (each.name.len)
-                str_cpy(&(*eo)[i].name, each.name);
+            if (each->name.len)
+                str_cpy(&(*eo)[i].name, each->name);
 
-            for (size_t j = 0; j < vec_size(each.options); j++)
-                vec_push((*eo)[i].options, str_init_from(each.options[j]));
+            for (size_t j = 0; j < vec_size(each->options); j++)
+                vec_push((*eo)[i].options, str_init_from(each->options[j]));
 
-            if (each.time)
-                (*eo)[i].time = each.time;
+            if (each->time)
+                (*eo)[i].time = each->time;
 
-            if (each.increment)
-                (*eo)[i].increment = each.increment;
+            if (each->increment)
+                (*eo)[i].increment = each->increment;
 
-            if (each.movetime)
-                (*eo)[i].movetime = each.movetime;
+            if (each->movetime)
+                (*eo)[i].movetime = each->movetime;
 
-            if (each.nodes)
-                (*eo)[i].nodes = each.nodes;
+            if (each->nodes)
+                (*eo)[i].nodes = each->nodes;
 
-            if (each.depth)
-                (*eo)[i].depth = each.depth;
+            if (each->depth)
+                (*eo)[i].depth = each->depth;
 
-            if (each.movestogo)
-                (*eo)[i].movestogo = each.movestogo;
+            if (each->movestogo)
+                (*eo)[i].movestogo = each->movestogo;
         }
     }
 
+    if (o->sprtSim) {
+        if (!o->sprt)
+            FAIL("-sprtsim requires -sprt\n");
+
+        return;  // simulation only: no engines needed
+    }
+
+    if (o->query.file.len || vec_size(o->merge) || o->adjSimParam.pgn.len || o->serveParam.port)
+        return;  // query, merge, adjudication simulation or engine server: no games
+
     if (vec_size(*eo) < 2)
-        DIE("at least 2 engines are needed\n");
+        FAIL("at least 2 engines are needed\n");
 
     if (vec_size(*eo) > 2 && o->sprt)
-        DIE("only 2 engines for SPRT\n");
+        FAIL("only 2 engines for SPRT\n");
+
+    if (o->tournament == TOURNAMENT_RACE && o->raceParam.reference && vec_size(*eo) < 3)
+        FAIL("-race reference needs at least 2 candidates besides the reference\n");
+
+    if (o->spsa && (vec_size(*eo) != 2 || o->games % 2 || !o->repeat || o->sprt))
+        FAIL("-spsa requires 2 engines, -repeat, an even number of -games, and no -sprt\n");
+
+    // SPSA uses job_queue_pop_pair(), which does not pair the next rounds of -swiss and -race
+    if (o->spsa && (o->tournament == TOURNAMENT_SWISS || o->tournament == TOURNAMENT_RACE))
+        FAIL("-spsa cannot be used with -swiss or -race\n");
+
+    for (int p = 0; p < NB_PHASE; p++)
+        if (!o->samplePolicy.rateSet[p])
+            o->samplePolicy.rate[p] = o->sampleFrequency;  // not given by -samplepolicy
+
+    if (o->spsa && o->selfPlay)
+        FAIL("-selfplay cannot be used with -spsa (engines need different options)\n");
+
+    if (o->order == ORDER_INFORMATIVE && !o->openingStats.len)
+        FAIL("order=informative requires stats=FILE in -openings\n");
+
+    if (o->pgnIndex && !o->pgn.len)
+        FAIL("-pgnindex requires -pgn\n");
+
+    if (o->balance && !o->openings.len)
+        FAIL("-balance requires an opening file\n");
+
+    if (o->balance && (o->balanceParam.engine < 0 || (size_t)o->balanceParam.engine >= vec_size(*eo)))
+        FAIL("Invalid engine for -balance\n");
+}
+
+void options_parse(int argc, const char **argv, Options *o, EngineOptions **eo)
+{
+    scope(engine_options_destroy) EngineOptions each = engine_options_init();
+    do_options_parse(argc, argv, o, eo, &each);
+}
+
+bool options_try_parse(int argc, const char **argv, Options *o, EngineOptions **eo, char *err,
+    size_t size)
+// Same as options_parse(), except that invalid options are not fatal: returns false, with the error
+// message in err (truncated to size bytes, as snprintf() does). Options and engines parsed so far are
+// left in *o and *eo, for the caller to destroy.
+{
+    EngineOptions *each = malloc(sizeof(EngineOptions));  // not a local: must survive longjmp()
+    *each = engine_options_init();
+    jmp_buf env;
+    Fail.env = &env;
+    Fail.buf = err;
+    Fail.size = size;
+    bool ok = false;
+
+    if (!setjmp(env)) {
+        do_options_parse(argc, argv, o, eo, each);
+        ok = true;
+    }
+
+    Fail.env = NULL;
+    engine_options_destroy(each);
+    free(each);
+    return ok;
 }
 
 void options_destroy(Options *o)
 {
-    str_destroy_n(&o->openings, &o->pgn, &o->sample);
+    str_destroy_n(&o->openings, &o->openingStats, &o->pgn, &o->sample, &o->gamedb, &o->results);
+    vec_destroy_rec(o->merge, str_destroy);
+    gamedb_query_destroy(&o->query);
+    adjsim_param_destroy(&o->adjSimParam);
+    adjudicator_param_destroy(&o->adjudicatorParam);
+    str_destroy_n(&o->serveParam.cmd, &o->serveParam.address);
+    spsa_param_destroy(&o->spsaParam);
 }
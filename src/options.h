@@ -14,21 +14,58 @@
 */
 #pragma once
 #include <inttypes.h>
+#include "adjsim.h"
+#include "adjudicator.h"
+#include "balance.h"
+#include "gamedb.h"
+#include "jobs.h"
 #include "workers.h"
+#include "spsa.h"
 #include "sprt.h"
 #include "str.h"
 
+// Engine server (-serve): remote engines for cmd=tcp://HOST:PORT
 typedef struct {
-    str_t openings, pgn, sample;
+    str_t cmd, address;
+    int port;
+    char pad[4];
+} ServeParam;
+
+enum {PHASE_OPENING, PHASE_MIDDLEGAME, PHASE_ENDGAME, NB_PHASE};
+
+// Sample selection policy: which positions are worth sampling
+typedef struct {
+    double rate[NB_PHASE];  // sample frequency, by game phase
+    int minPly, maxPly;  // range of game plies (starting from 0)
+    int maxScore;  // discard scores beyond +/-maxScore (including mate scores)
+    int skipEnd;  // discard samples of the last skipEnd plies of adjudicated games
+    int maxPerGame;  // keep at most maxPerGame samples per game (0 = no limit)
+    bool rateSet[NB_PHASE];  // rate[phase] given by -samplepolicy (otherwise: -sample freq)
+    char pad[1];
+} SamplePolicy;
+
+typedef struct {
+    str_t openings, openingStats, pgn, sample, gamedb, results;
+    str_t *merge;  // results files to merge
+    GameDBQuery query;
+    AdjSimParam adjSimParam;
+    AdjudicatorParam adjudicatorParam;
+    ServeParam serveParam;
     SPRTParam sprtParam;
+    SPRTSimParam sprtSimParam;
+    BalanceParam balanceParam;
+    SPSAParam spsaParam;
+    RaceParam raceParam;
+    SamplePolicy samplePolicy;
     uint64_t srand;
     double sampleFrequency;
-    int concurrency, games, rounds;
+    int concurrency, games, rounds, order, tournament;
     int resignCount, resignScore;
     int drawCount, drawScore;
     int pgnVerbosity;
-    bool log, random, repeat, sprt, gauntlet, sampleResolvePv;
-    char pad[2];
+    int memStats;  // memory report period in seconds (0: at exit only, -1: disabled)
+    bool log, repeat, sprt, sampleResolvePv, sampleMultiPv, balance, spsa, sprtSim, pgnIndex,
+        numa, selfPlay, perf;
 } Options;
 
 typedef struct {
@@ -39,7 +76,10 @@ typedef struct {
 
 EngineOptions engine_options_init(void);
 void engine_options_destroy(EngineOptions *eo);
+bool engine_options_same_process(const EngineOptions *a, const EngineOptions *b);
 
 Options options_init(void);
 void options_parse(int argc, const char **argv, Options *o, EngineOptions **eo);
+bool options_try_parse(int argc, const char **argv, Options *o, EngineOptions **eo, char *err,
+    size_t size);
 void options_destroy(Options *o);
@@ -0,0 +1,211 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#ifdef __linux__
+    #define _GNU_SOURCE
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "perf.h"
+#include "util.h"
+#include "vec.h"
+
+bool PerfStats;
+
+typedef struct {
+    uint64_t count[NB_PERF];
+    uint64_t games;
+} PerfTotal;
+
+static struct {
+    pthread_mutex_t mtx;
+    PerfTotal *totals;  // totals[engine * concurrency + level - 1]
+    int engines, concurrency;
+    bool available[NB_PERF];
+    char pad[5];
+} Perf;
+
+#ifdef __linux__
+
+static int perf_event_open(int event, pid_t pid)
+// Count 'event' in user space, for process 'pid' and the threads it creates afterwards
+{
+    static const uint64_t config[NB_PERF] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES};  // cache misses: usually last level cache
+
+    struct perf_event_attr attr = {
+        .size = sizeof(attr),
+        .type = PERF_TYPE_HARDWARE,
+        .config = config[event],
+        .inherit = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+        .read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+    };
+
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+#else
+
+static int perf_event_open(int event, pid_t pid)
+{
+    (void)event; (void)pid;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+void perf_init(int engines, int concurrency, FILE *out)
+// Enable counters, unless none of them is available (eg. in a virtual machine, or because of
+// /proc/sys/kernel/perf_event_paranoid), which is reported on 'out'
+{
+    int error = 0;
+
+    for (int i = 0; i < NB_PERF; i++) {
+        const int fd = perf_event_open(i, 0);
+
+        if ((Perf.available[i] = fd >= 0))
+            DIE_IF(0, close(fd) < 0);
+        else
+            error = errno;
+    }
+
+    PerfStats = Perf.available[PERF_CYCLES] || Perf.available[PERF_INSTRUCTIONS]
+        || Perf.available[PERF_LLC_MISSES];
+
+    if (!PerfStats) {
+        DIE_IF(0, fprintf(out, "Perf: hardware counters are not available (%s)\n",
+            strerror(error)) < 0);
+        return;
+    }
+
+    pthread_mutex_init(&Perf.mtx, NULL);
+    Perf.totals = vec_init_reserve((size_t)(engines * concurrency), PerfTotal);
+    Perf.engines = engines;
+    Perf.concurrency = concurrency;
+
+    for (int i = 0; i < engines * concurrency; i++)
+        vec_push(Perf.totals, (PerfTotal){0});
+}
+
+void perf_destroy(void)
+{
+    if (PerfStats) {
+        vec_destroy(Perf.totals);
+        pthread_mutex_destroy(&Perf.mtx);
+    }
+
+    Perf = (typeof(Perf)){0};
+    PerfStats = false;
+}
+
+void perf_open(int fd[NB_PERF], pid_t pid)
+// Attach counters to process 'pid', before it creates any thread. fd[i] is -1 when counter i is not
+// available (or if pid <= 0).
+{
+    for (int i = 0; i < NB_PERF; i++)
+        fd[i] = PerfStats && Perf.available[i] && pid > 0 ? perf_event_open(i, pid) : -1;
+}
+
+void perf_close(int fd[NB_PERF])
+{
+    for (int i = 0; i < NB_PERF; i++)
+        if (fd[i] >= 0) {
+            DIE_IF(0, close(fd[i]) < 0);
+            fd[i] = -1;
+        }
+}
+
+void perf_read(const int fd[NB_PERF], uint64_t count[NB_PERF])
+// Read counters since the process was spawned (0 if not available)
+{
+    for (int i = 0; i < NB_PERF; i++) {
+        uint64_t value[3] = {0};  // count, time enabled, time running
+        count[i] = 0;
+
+        if (fd[i] >= 0 && read(fd[i], value, sizeof(value)) == sizeof(value) && value[2]) {
+            // Extrapolate, when the kernel multiplexes more events than hardware counters
+            count[i] = value[2] < value[1]
+                ? (uint64_t)((double)value[0] * (double)value[1] / (double)value[2])
+                : value[0];
+        }
+    }
+}
+
+void perf_add(const int fd[NB_PERF], const uint64_t start[NB_PERF], int engine, int level)
+// Add the counts of a game, since 'start' (read with perf_read() when the game started), to the
+// totals of (engine, level)
+{
+    uint64_t end[NB_PERF];
+    perf_read(fd, end);
+
+    level = level < 1 ? 1 : level > Perf.concurrency ? Perf.concurrency : level;
+    pthread_mutex_lock(&Perf.mtx);
+
+    PerfTotal *t = &Perf.totals[engine * Perf.concurrency + level - 1];
+    t->games++;
+
+    for (int i = 0; i < NB_PERF; i++)
+        t->count[i] += end[i] > start[i] ? end[i] - start[i] : 0;
+
+    pthread_mutex_unlock(&Perf.mtx);
+}
+
+void perf_print(const str_t *names, FILE *out)
+// One line per (engine, concurrency level) with games: totals, instructions per cycle, and LLC misses
+// per 1000 instructions
+{
+    scope(str_destroy) str_t report = str_init_from_c("Perf: engine, concurrency, games, cycles, "
+        "instructions, LLC misses, IPC, LLC misses per 1000 instructions\n");
+
+    for (int engine = 0; engine < Perf.engines; engine++)
+        for (int level = 1; level <= Perf.concurrency; level++) {
+            const PerfTotal *t = &Perf.totals[engine * Perf.concurrency + level - 1];
+
+            if (!t->games)
+                continue;
+
+            str_cat_fmt(&report, "Perf: %S, %i, %U", names[engine], level, (uintmax_t)t->games);
+
+            for (int i = 0; i < NB_PERF; i++)
+                if (Perf.available[i])
+                    str_cat_fmt(&report, ", %U", (uintmax_t)t->count[i]);
+                else
+                    str_cat_c(&report, ", -");
+
+            char ipc[16] = "-", mpki[16] = "-";
+            const uint64_t instructions = t->count[PERF_INSTRUCTIONS];
+
+            if (instructions && t->count[PERF_CYCLES])
+                snprintf(ipc, sizeof(ipc), "%.3f",
+                    (double)instructions / (double)t->count[PERF_CYCLES]);
+
+            if (instructions && Perf.available[PERF_LLC_MISSES])
+                snprintf(mpki, sizeof(mpki), "%.3f",
+                    1000 * (double)t->count[PERF_LLC_MISSES] / (double)instructions);
+
+            str_cat_fmt(&report, ", %s, %s\n", ipc, mpki);
+        }
+
+    DIE_IF(0, fputs(report.buf, out) < 0);
+}
@@ -0,0 +1,44 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "str.h"
+
+// Hardware performance counters of engine processes (-perf, Linux only). Counters are attached to
+// each engine process when it is spawned (and inherited by its threads). Each game adds the counts of
+// its engines to the totals of (engine, concurrency level), where the concurrency level is the number
+// of games in progress when it started.
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    NB_PERF
+};
+
+extern bool PerfStats;  // counters are enabled (and available)
+
+void perf_init(int engines, int concurrency, FILE *out);
+void perf_destroy(void);
+
+void perf_open(int fd[NB_PERF], pid_t pid);
+void perf_close(int fd[NB_PERF]);
+
+void perf_read(const int fd[NB_PERF], uint64_t count[NB_PERF]);
+void perf_add(const int fd[NB_PERF], const uint64_t start[NB_PERF], int engine, int level);
+
+void perf_print(const str_t *names, FILE *out);
@@ -174,13 +174,13 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
 // sfen: if != NULL, auto-detect S-FEN.
 {
     *pos = (Position){0};
-    scope(str_destroy) str_t token = str_init();
+    strv_t token = {0};  // view of fen
 
     // Piece placement
-    fen = str_tok(fen, &token, " ");
+    fen = strv_tok(fen, &token, " ");
     int rank = RANK_8, file = FILE_A;
 
-    for (const char *c = token.buf; *c; c++) {
+    for (const char *c = token.buf; c < token.buf + token.len; c++) {
         if ('1' <= *c && *c <= '8') {
             file += *c -'0';
 
@@ -203,7 +203,7 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
         return false;
 
     // Turn of play
-    fen = str_tok(fen, &token, " ");
+    fen = strv_tok(fen, &token, " ");
 
     if (token.len != 1)
         return false;
@@ -221,11 +221,11 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
     // Castling rights: optional, default '-'
     bool _sfen = false;
 
-    if ((fen = str_tok(fen, &token, " "))) {
+    if ((fen = strv_tok(fen, &token, " "))) {
         if (token.len > 4)
             return false;
 
-        for (const char *c = token.buf; *c; c++) {
+        for (const char *c = token.buf; c < token.buf + token.len; c++) {
             rank = isupper((unsigned char)*c) ? RANK_1 : RANK_8;
             const bitboard_t ourRooks = pos_pieces_cp(pos, rank / RANK_8, ROOK);
             const char uc = (char)toupper(*c);
@@ -237,7 +237,7 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
             else if ('A' <= uc && uc <= 'H') {
                 bb_set(&pos->castleRooks, square_from(rank, uc - 'A'));
                 _sfen = true;
-            } else if (*c != '-' || pos->castleRooks || c[1] != '\0')
+            } else if (*c != '-' || pos->castleRooks || token.len != 1)
                 return false;
         }
     }
@@ -260,8 +260,8 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
     }
 
     // En passant square: optional, default '-'
-    if (!(fen = str_tok(fen, &token, " ")))
-        str_cpy_c(&token, "-");
+    if (!(fen = strv_tok(fen, &token, " ")))
+        token = strv_ref("-");
 
     if (token.len > 2)
         return false;
@@ -270,13 +270,13 @@ bool pos_set(Position *pos, const char *fen, bool force960, bool *sfen)
     pos->key ^= ZobristEnPassant[pos->epSquare];
 
     // 50 move counter (in plies, starts at 0): optional, default 0
-    pos->rule50 = (fen = str_tok(fen, &token, " ")) ? (uint8_t)atoi(token.buf) : 0;
+    pos->rule50 = (fen = strv_tok(fen, &token, " ")) ? (uint8_t)strv_to_int(token) : 0;
 
     if (pos->rule50 >= 100)
         return false;
 
     // Full move counter (in moves, starts at 1): optional, default 1
-    pos->fullMove = str_tok(fen, &token, " ") ? (uint16_t)atoi(token.buf) : 1;
+    pos->fullMove = strv_tok(fen, &token, " ") ? (uint16_t)strv_to_int(token) : 1;
 
     // Verify piece counts
     for (int color = WHITE; color <= BLACK; color++)
@@ -560,13 +560,13 @@ void pos_move_to_lan(const Position *pos, move_t m, str_t *lan)
         str_push(lan, PieceLabel[BLACK][prom]);
 }
 
-move_t pos_lan_to_move(const Position *pos, const char *lan)
+move_t pos_lan_to_move(const Position *pos, strv_t lan)
 {
-    const int prom = lan[4]
-        ? (int)(strchr(PieceLabel[BLACK], lan[4]) - PieceLabel[BLACK])
+    const int prom = lan.len > 4
+        ? (int)(strchr(PieceLabel[BLACK], lan.buf[4]) - PieceLabel[BLACK])
         : NB_PIECE;
-    const int from = square_from(lan[1] - '1', lan[0] - 'a');
-    int to = square_from(lan[3] - '1', lan[2] - 'a');
+    const int from = square_from(lan.buf[1] - '1', lan.buf[0] - 'a');
+    int to = square_from(lan.buf[3] - '1', lan.buf[2] - 'a');
 
     if (!pos->chess960 && pos_piece_on(pos, from) == KING) {
         if (to == from + 2)  // e1g1 -> e1h1
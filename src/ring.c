@@ -0,0 +1,55 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stddef.h>
+#include <string.h>
+#include "ring.h"
+
+ring_t *ring_ptr(void *r)
+{
+    assert(r);
+    return (ring_t *)((char *)(r) - offsetof(ring_t, buf));
+}
+
+const ring_t *ring_cptr(const void *r)
+{
+    return (const ring_t *)((const char *)(r) - offsetof(ring_t, buf));
+}
+
+void *ring_do_init(size_t capacity, size_t esize)
+{
+    assert(capacity > 0);
+    ring_t *r = malloc(sizeof(ring_t) + capacity * esize);
+    r->capacity = capacity;
+    r->head = r->size = 0;
+    return (void *)r->buf;
+}
+
+size_t ring_size(const void *r)
+{
+    return r ? ring_cptr(r)->size : 0;
+}
+
+void ring_do_remove(void *r, size_t esize, size_t i)
+// Shift the elements after i one slot towards the head
+{
+    ring_t *p = ring_ptr(r);
+    assert(i < p->size);
+
+    for (; i + 1 < p->size; i++)
+        memcpy(&p->buf[(p->head + i) % p->capacity * esize],
+            &p->buf[(p->head + i + 1) % p->capacity * esize], esize);
+
+    p->size--;
+}
@@ -0,0 +1,63 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Ring buffer: bounded FIFO, whose capacity is fixed at creation. Push and pop are O(1), instead of
+// removing the first element of a vec with memmove(). Not thread safe: shared rings are protected by
+// their owner's lock (which consumers need anyway, to wait on a condition variable).
+typedef struct {
+    size_t capacity;
+    size_t head;  // index of the first element in buf[]
+    size_t size;
+    char buf[];
+} ring_t;
+
+ring_t *ring_ptr(void *r);
+const ring_t *ring_cptr(const void *r);
+
+void *ring_do_init(size_t capacity, size_t esize);
+#define ring_init(capacity, etype) ring_do_init(capacity, sizeof(etype))
+
+#define ring_destroy(r) ({ \
+    if (r) free(ring_ptr(r)); \
+    r = NULL; \
+})
+
+size_t ring_size(const void *r);
+
+// i-th element, starting from the first one (next to be popped)
+#define ring_at(r, i) ((r)[(ring_cptr(r)->head + (i)) % ring_cptr(r)->capacity])
+
+#define ring_push(r, e) ({ \
+    ring_t *_r = ring_ptr(r); \
+    assert(_r->size < _r->capacity); \
+    (r)[(_r->head + _r->size++) % _r->capacity] = (e); \
+})
+
+#define ring_pop(r) ({ \
+    ring_t *_r = ring_ptr(r); \
+    assert(_r->size); \
+    const size_t _i = _r->head; \
+    _r->head = (_r->head + 1) % _r->capacity; \
+    _r->size--; \
+    (r)[_i]; \
+})
+
+// remove the i-th element, preserving the order of the others: O(n), for occasional use
+void ring_do_remove(void *r, size_t esize, size_t i);
+#define ring_remove(r, i) ring_do_remove(r, sizeof(*(r)), i)
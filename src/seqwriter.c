@@ -13,7 +13,9 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #include <string.h>
+#include "memstats.h"
 #include "seqwriter.h"
+#include "util.h"
 #include "vec.h"
 
 static SeqStr seq_str_init(size_t idx, str_t str)
@@ -29,12 +31,22 @@ static void seq_str_destroy(SeqStr *ss)
     str_destroy(&ss->str);
 }
 
-SeqWriter seq_writer_init(const char *fileName, const char *mode)
+SeqWriter seq_writer_init(const char *fileName, const char *mode, const char *indexName)
+// If indexName is not NULL, the index file is (re)written with one SeqIndex per idx, starting from
+// idx = 0. Offsets are absolute, so they remain valid when appending to an existing file.
 {
+    scope(memstats_leave) int memTag = memstats_enter(MEM_SEQWRITER);
     SeqWriter sw = {0};
-    sw.out = fopen(fileName, mode);
+    DIE_IF(0, !(sw.out = fopen(fileName, mode)));
     sw.buf = vec_init(SeqStr);
     pthread_mutex_init(&sw.mtx, NULL);
+
+    if (indexName) {
+        DIE_IF(0, !(sw.index = fopen(indexName, "we")));
+        DIE_IF(0, fseek(sw.out, 0, SEEK_END) < 0);
+        sw.offset = (uint64_t)ftell(sw.out);
+    }
+
     return sw;
 }
 
@@ -43,10 +55,14 @@ void seq_writer_destroy(SeqWriter *sw)
     pthread_mutex_destroy(&sw->mtx);
     vec_destroy_rec(sw->buf, seq_str_destroy);
     fclose(sw->out);
+
+    if (sw->index)
+        DIE_IF(0, fclose(sw->index) < 0);
 }
 
 void seq_writer_push(SeqWriter *sw, size_t idx, str_t str)
 {
+    scope(memstats_leave) int memTag = memstats_enter(MEM_SEQWRITER);
     pthread_mutex_lock(&sw->mtx);
 
     // Append to sw->buf[n]
@@ -74,10 +90,20 @@ void seq_writer_push(SeqWriter *sw, size_t idx, str_t str)
         // Write buf[0..i-1] to file, and destroy elements
         for (size_t j = 0; j < i; j++) {
             fputs(sw->buf[j].str.buf, sw->out);
+
+            if (sw->index) {
+                const SeqIndex si = {.offset = sw->offset, .length = sw->buf[j].str.len};
+                DIE_IF(0, fwrite(&si, sizeof(si), 1, sw->index) != 1);
+                sw->offset += si.length;
+            }
+
             seq_str_destroy(&sw->buf[j]);
         }
         fflush(sw->out);
 
+        if (sw->index)
+            fflush(sw->index);
+
         // Delete buf[0..i-1]
         memmove(&sw->buf[0], &sw->buf[i], (vec_size(sw->buf) - i) * sizeof(SeqStr));
         vec_ptr(sw->buf)->size -= i;
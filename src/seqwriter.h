@@ -13,6 +13,7 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include "str.h"
@@ -22,14 +23,21 @@ typedef struct {
     str_t str;
 } SeqStr;
 
+// Entry of the (optional) index file: where the string of a given idx was written in the output file
+typedef struct {
+    uint64_t offset, length;
+} SeqIndex;
+
 typedef struct {
     pthread_mutex_t mtx;
     SeqStr *buf;
     FILE *out;
+    FILE *index;  // if not NULL, write a SeqIndex for each idx (in idx order)
     size_t idxNext;
+    uint64_t offset;  // current size of the output file
 } SeqWriter;
 
-SeqWriter seq_writer_init(const char *fileName, const char *mode);
+SeqWriter seq_writer_init(const char *fileName, const char *mode, const char *indexName);
 void seq_writer_destroy(SeqWriter *sw);
 
 void seq_writer_push(SeqWriter *sw, size_t idx, str_t str);
@@ -13,7 +13,10 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include "sprt.h"
+#include "util.h"
 
 static double elo_to_score(double elo)
 {
@@ -43,20 +46,141 @@ bool sprt_validate(const SPRTParam *sp)
         && sp->elo0 < sp->elo1;
 }
 
-bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp)
+static void sprt_bounds(const SPRTParam *sp, double *lbound, double *ubound)
 {
-    const double lbound = log(sp->beta / (1 - sp->alpha));
-    const double ubound = log((1 - sp->beta) / sp->alpha);
+    *lbound = log(sp->beta / (1 - sp->alpha));
+    *ubound = log((1 - sp->beta) / sp->alpha);
+}
+
+bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp, FILE *out)
+{
+    double lbound, ubound;
+    sprt_bounds(sp, &lbound, &ubound);
     const double llr = sprt_llr(wldCount, sp->elo0, sp->elo1);
 
     if (llr > ubound) {
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H1 accepted.\n", llr, lbound, ubound);
+        fprintf(out, "SPRT: LLR = %.3f [%.3f,%.3f]. H1 accepted.\n", llr, lbound, ubound);
         return true;
     } else if (llr < lbound) {
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]. H0 accepted.\n", llr, lbound, ubound);
+        fprintf(out, "SPRT: LLR = %.3f [%.3f,%.3f]. H0 accepted.\n", llr, lbound, ubound);
         return true;
     } else
-        printf("SPRT: LLR = %.3f [%.3f,%.3f]\n", llr, lbound, ubound);
+        fprintf(out, "SPRT: LLR = %.3f [%.3f,%.3f]\n", llr, lbound, ubound);
 
     return false;
 }
+
+bool sprt_sim_validate(const SPRTSimParam *sim)
+{
+    const double s = elo_to_score(sim->elo);
+
+    return 0 <= sim->draw && sim->draw < 1
+        && sim->draw / 2 <= s && sim->draw / 2 <= 1 - s  // win and loss probabilities >= 0
+        && sim->runs > 0 && sim->maxGames > 0;
+}
+
+typedef struct {
+    pthread_mutex_t mtx;
+    const SPRTParam *sp;
+    const SPRTSimParam *sim;
+    int *games;  // games[run]: number of games played
+    int *outcome;  // outcome[run]: 1 if H1 accepted, -1 if H0 accepted, 0 if truncated (maxGames)
+    uint64_t seed;  // PRNG state of run 0 (run r starts at seed + r)
+    int next;  // next run to simulate
+    char pad[4];
+} SPRTSim;
+
+static void *sprt_sim_thread_start(void *arg)
+{
+    SPRTSim *ss = arg;
+    const double s = elo_to_score(ss->sim->elo);
+    const double pWin = s - ss->sim->draw / 2, pLoss = 1 - s - ss->sim->draw / 2;
+    double lbound, ubound;
+    sprt_bounds(ss->sp, &lbound, &ubound);
+
+    while (true) {
+        pthread_mutex_lock(&ss->mtx);
+        const int run = ss->next++;
+        pthread_mutex_unlock(&ss->mtx);
+
+        if (run >= ss->sim->runs)
+            break;
+
+        // Each run has its own PRNG stream, so that results do not depend on the number of threads
+        uint64_t seed = ss->seed + (uint64_t)run;
+        int wldCount[NB_RESULT] = {0}, n = 0, outcome = 0;
+
+        while (n < ss->sim->maxGames) {
+            const double x = prngf(&seed);
+            wldCount[x < pWin ? RESULT_WIN : x < pWin + pLoss ? RESULT_LOSS : RESULT_DRAW]++;
+            n++;
+
+            const double llr = sprt_llr(wldCount, ss->sp->elo0, ss->sp->elo1);
+
+            if (llr > ubound || llr < lbound) {
+                outcome = llr > ubound ? 1 : -1;
+                break;
+            }
+        }
+
+        // Each run writes its own slot: no lock needed
+        ss->games[run] = n;
+        ss->outcome[run] = outcome;
+    }
+
+    return NULL;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+    const int x = *(const int *)a, y = *(const int *)b;
+    return x < y ? -1 : x > y;
+}
+
+void sprt_simulate(const SPRTParam *sp, const SPRTSimParam *sim, int threads)
+// Simulate sim->runs SPRTs concurrently, and report the probability of accepting H1, as well as the
+// distribution of the number of games needed to conclude.
+{
+    // Mix srand into the base seed, so that nearby srand values do not give overlapping runs
+    const uint64_t srand = sim->srand ? sim->srand : (uint64_t)system_msec();
+    uint64_t state = srand;
+    SPRTSim ss = {.sp = sp, .sim = sim, .seed = prng(&state)};
+    pthread_mutex_init(&ss.mtx, NULL);
+    ss.games = calloc((size_t)sim->runs, sizeof(int));
+    ss.outcome = calloc((size_t)sim->runs, sizeof(int));
+
+    pthread_t *t = calloc((size_t)threads, sizeof(pthread_t));
+
+    for (int i = 0; i < threads; i++)
+        pthread_create(&t[i], NULL, sprt_sim_thread_start, &ss);
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(t[i], NULL);
+
+    int count[3] = {0};  // H0 accepted, truncated, H1 accepted
+    double total = 0;
+
+    for (int run = 0; run < sim->runs; run++) {
+        count[ss.outcome[run] + 1]++;
+        total += ss.games[run];
+    }
+
+    qsort(ss.games, (size_t)sim->runs, sizeof(int), compare_int);
+    const double p = (double)count[2] / sim->runs;
+
+    printf("SPRT simulation: elo=%.2f draw=%.3f, elo0=%.2f elo1=%.2f alpha=%.3f beta=%.3f, %d runs"
+        " (srand=%" PRIu64 ")\n", sim->elo, sim->draw, sp->elo0, sp->elo1, sp->alpha, sp->beta,
+        sim->runs, srand);
+    printf("H1 accepted: %.4f +/- %.4f, H0 accepted: %.4f, truncated at %d games: %.4f\n", p,
+        sqrt(p * (1 - p) / sim->runs), (double)count[0] / sim->runs, sim->maxGames,
+        (double)count[1] / sim->runs);
+    printf("Games: average %.0f, percentiles 5%% %d, 25%% %d, 50%% %d, 75%% %d, 95%% %d\n",
+        total / sim->runs, ss.games[sim->runs * 5 / 100], ss.games[sim->runs * 25 / 100],
+        ss.games[sim->runs * 50 / 100], ss.games[sim->runs * 75 / 100],
+        ss.games[sim->runs * 95 / 100]);
+
+    free(t);
+    free(ss.outcome);
+    free(ss.games);
+    pthread_mutex_destroy(&ss.mtx);
+}
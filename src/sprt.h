@@ -13,11 +13,22 @@
  * not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
+#include <inttypes.h>
 #include "workers.h"
 
 typedef struct {
     double elo0, elo1, alpha, beta;
 } SPRTParam;
 
+// Simulation: play SPRTs with games drawn from a trinomial distribution (true elo, draw ratio)
+typedef struct {
+    double elo, draw;
+    int runs, maxGames;
+    uint64_t srand;  // 0: unpredictable seed
+} SPRTSimParam;
+
 bool sprt_validate(const SPRTParam *sp);
-bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp);
+bool sprt_done(int wldCount[NB_RESULT], const SPRTParam *sp, FILE *out);
+
+bool sprt_sim_validate(const SPRTSimParam *sim);
+void sprt_simulate(const SPRTParam *sp, const SPRTSimParam *sim, int threads);
@@ -0,0 +1,142 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <string.h>
+#include "spsa.h"
+#include "util.h"
+#include "vec.h"
+
+bool spsa_parse_tunable(const char *s, SPSATunable *t)
+// Parse 'NAME=VALUE,MIN,MAX,C,STEP'
+{
+    scope(str_destroy) str_t token = str_init();
+    const char *tail = str_tok(s, &t->name, "=");
+    double *fields[] = {&t->value, &t->min, &t->max, &t->c, &t->a};
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(*fields); i++) {
+        if (!(tail = str_tok(tail, &token, "=,")))
+            return false;
+
+        *fields[i] = atof(token.buf);
+    }
+
+    return t->name.len && t->min <= t->value && t->value <= t->max && t->c > 0 && t->a > 0;
+}
+
+static void spsa_tunable_destroy(SPSATunable *t)
+{
+    str_destroy(&t->name);
+}
+
+void spsa_param_destroy(SPSAParam *sp)
+{
+    vec_destroy_rec(sp->tunables, spsa_tunable_destroy);
+}
+
+SPSA spsa_init(const SPSAParam *sp, FILE *out)
+{
+    SPSA s = {0};
+    pthread_mutex_init(&s.mtx, NULL);
+    s.sp = sp;
+    s.out = out;
+    s.theta = vec_init_reserve(vec_size(sp->tunables), double);
+
+    for (size_t i = 0; i < vec_size(sp->tunables); i++)
+        vec_push(s.theta, sp->tunables[i].value);
+
+    return s;
+}
+
+void spsa_destroy(SPSA *s)
+{
+    vec_destroy(s->theta);
+    pthread_mutex_destroy(&s->mtx);
+}
+
+SPSAIteration spsa_iteration_init(void)
+{
+    return (SPSAIteration){
+        .plus = vec_init(double),
+        .minus = vec_init(double),
+        .delta = vec_init(int)
+    };
+}
+
+void spsa_iteration_destroy(SPSAIteration *it)
+{
+    vec_destroy(it->plus);
+    vec_destroy(it->minus);
+    vec_destroy(it->delta);
+}
+
+void spsa_perturb(SPSA *s, uint64_t *seed, SPSAIteration *it)
+// Draw random signs delta[i], and perturb theta[i] by +/- c_k * delta[i]. Both values are clamped
+// to [min, max], and rounded to the integers sent to the engines.
+{
+    vec_clear(it->plus);
+    vec_clear(it->minus);
+    vec_clear(it->delta);
+
+    pthread_mutex_lock(&s->mtx);
+
+    it->k = s->iterations++;
+    const double ck = 1 / pow(it->k + 1, s->sp->gamma);
+
+    for (size_t i = 0; i < vec_size(s->theta); i++) {
+        const SPSATunable *t = &s->sp->tunables[i];
+        const int delta = prng(seed) & 1 ? 1 : -1;
+        vec_push(it->delta, delta);
+        const double step = t->c * ck * delta;
+        const double plus = min(t->max, s->theta[i] + step);
+        const double minus = min(t->max, s->theta[i] - step);
+        vec_push(it->plus, round(max(t->min, plus)));
+        vec_push(it->minus, round(max(t->min, minus)));
+    }
+
+    pthread_mutex_unlock(&s->mtx);
+}
+
+void spsa_update(SPSA *s, const SPSAIteration *it, int result)
+// 'result' is the score difference between engines[0] (plus) and engines[1] (minus), over a pair of
+// games: wins - losses of engines[0], ranging from -2 to +2. Gradient ascent step:
+// theta[i] += a_k * result / (plus[i] - minus[i])
+// using the values actually played (rounded and clamped), rather than 2 * c_k * delta[i]. When
+// they are equal, the games carry no information about theta[i], which is left unchanged: dividing
+// by the (small) unrounded perturbation would only amplify noise.
+{
+    pthread_mutex_lock(&s->mtx);
+
+    const SPSAParam *sp = s->sp;
+    const double ak = 1 / pow(it->k + 1 + sp->A, sp->alpha);
+    scope(str_destroy) str_t out = str_init();
+    str_cpy_fmt(&out, "SPSA iteration %i:", ++s->updates);
+
+    for (size_t i = 0; i < vec_size(s->theta); i++) {
+        const SPSATunable *t = &sp->tunables[i];
+        const double diff = it->plus[i] - it->minus[i];
+
+        if (diff != 0) {
+            const double theta = min(t->max, s->theta[i] + t->a * ak * result / diff);
+            s->theta[i] = max(t->min, theta);
+        }
+
+        char value[32] = "";
+        sprintf(value, "%.3f", s->theta[i]);
+        str_cat_fmt(&out, " %S=%s", t->name, value);
+    }
+
+    fprintf(s->out, "%s\n", out.buf);
+    pthread_mutex_unlock(&s->mtx);
+}
@@ -0,0 +1,61 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include "str.h"
+
+// A tunable parameter, sent to engines as 'setoption name NAME value VALUE'
+typedef struct {
+    str_t name;
+    double value, min, max;
+    double c, a;  // perturbation size and step size (at iteration 0)
+} SPSATunable;
+
+typedef struct {
+    SPSATunable *tunables;
+    double alpha, gamma, A;  // decays: step a_k = a/(k+1+A)^alpha, perturbation c_k = c/(k+1)^gamma
+} SPSAParam;
+
+// Perturbation drawn for one iteration: engines[0] plays with 'plus', engines[1] with 'minus'
+typedef struct {
+    double *plus, *minus;
+    int *delta;  // random signs (+1 or -1)
+    int k;  // iteration number (starts at 0)
+    char pad[4];
+} SPSAIteration;
+
+// SPSA tuning state (thread safe)
+typedef struct {
+    pthread_mutex_t mtx;
+    const SPSAParam *sp;
+    double *theta;  // current values of tunables
+    FILE *out;  // where each iteration is reported
+    int iterations;  // number of iterations started
+    int updates;  // number of iterations completed
+} SPSA;
+
+bool spsa_parse_tunable(const char *s, SPSATunable *t);
+void spsa_param_destroy(SPSAParam *sp);
+
+SPSA spsa_init(const SPSAParam *sp, FILE *out);
+void spsa_destroy(SPSA *s);
+
+SPSAIteration spsa_iteration_init(void);
+void spsa_iteration_destroy(SPSAIteration *it);
+
+void spsa_perturb(SPSA *s, uint64_t *seed, SPSAIteration *it);
+void spsa_update(SPSA *s, const SPSAIteration *it, int result);
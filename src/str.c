@@ -17,6 +17,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include "memstats.h"
 #include "str.h"
 #include "util.h"
 
@@ -51,8 +52,19 @@ static void str_resize(str_t *s, size_t len)
 
     // Implement lazy realloc strategy
     if (s->alloc < str_round_up(len + 1)) {
+        // The block starts with a header: the subsystem charged for it, -1 if not accounted (see
+        // memstats.h)
+        int64_t *block = s->buf ? (int64_t *)s->buf - 1 : NULL;
+        const int64_t tag = block ? *block : MemStats ? memstats_tag() : -1;
+        const size_t oldSize = block ? sizeof(*block) + s->alloc : 0;
+
         s->alloc = str_round_up(len + 1);
-        s->buf = realloc(s->buf, s->alloc);
+        block = realloc(block, sizeof(*block) + s->alloc);
+        *block = tag;
+        s->buf = (char *)(block + 1);
+
+        if (tag >= 0)
+            memstats_update((int)tag, (int64_t)(sizeof(*block) + s->alloc - oldSize), true);
     }
 
     s->len = len;
@@ -113,7 +125,15 @@ str_t str_init_from(const str_t src)
 
 void str_destroy(str_t *s)
 {
-    free(s->buf);
+    if (s->buf) {
+        int64_t *block = (int64_t *)s->buf - 1;
+
+        if (*block >= 0)
+            memstats_update((int)*block, -(int64_t)(sizeof(*block) + s->alloc), false);
+
+        free(block);
+    }
+
     s->buf = NULL;
 }
 
@@ -149,6 +169,12 @@ str_t *str_cat(str_t *dest, const str_t src)
     return do_str_cat(dest, src.buf, src.len);
 }
 
+str_t *str_cpy_v(str_t *dest, strv_t src)
+{
+    str_resize(dest, 0);
+    return do_str_cat(dest, src.buf, src.len);
+}
+
 static char *do_fmt_u(uintmax_t n, char *s)
 {
     *s-- = '\0';
@@ -305,6 +331,59 @@ const char *str_prefix(const char *s, const char *prefix)
     return strncmp(s, prefix, len) ? NULL : s + len;
 }
 
+const char *strv_tok(const char *s, strv_t *token, const char *delim)
+{
+    assert(delim && *delim);
+
+    // empty tail: no-op
+    if (!s)
+        return NULL;
+
+    // eat delimiters before token, then non delimiters into token
+    s += strspn(s, delim);
+    *token = (strv_t){.buf = s, .len = strcspn(s, delim)};
+
+    // return string tail or NULL if token empty
+    return token->len ? s + token->len : NULL;
+}
+
+strv_t str_view(const str_t s)
+{
+    return (strv_t){.buf = s.buf, .len = s.len};
+}
+
+strv_t strv_ref(const char *s)
+{
+    return (strv_t){.buf = s, .len = strlen(s)};
+}
+
+bool strv_eq_c(strv_t sv, const char *s)
+{
+    return !strncmp(sv.buf, s, sv.len) && !s[sv.len];
+}
+
+int64_t strv_to_int(strv_t sv)
+{
+    size_t i = 0;
+    const bool negative = sv.len && sv.buf[0] == '-';
+    i += sv.len && (sv.buf[0] == '-' || sv.buf[0] == '+');
+    uint64_t n = 0;
+
+    for (; i < sv.len && '0' <= sv.buf[i] && sv.buf[i] <= '9'; i++)
+        n = 10 * n + (uint64_t)(sv.buf[i] - '0');
+
+    return negative ? -(int64_t)n : (int64_t)n;
+}
+
+double strv_to_double(strv_t sv)
+{
+    char buf[64];  // longer views are not numbers anyway
+    const size_t n = min(sv.len, sizeof(buf) - 1);
+    memcpy(buf, sv.buf, n);
+    buf[n] = '\0';
+    return atof(buf);
+}
+
 size_t str_getline(str_t *out, FILE *in)
 {
     assert(str_ok(*out) && in);
@@ -14,6 +14,7 @@
 */
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -23,6 +24,13 @@ typedef struct {
     size_t len;  // number of characters for string content, excluding '\0' terminator
 } str_t;
 
+// Non-owning view of len characters at buf (not '\0' terminated). Valid as long as the underlying
+// string is not modified or destroyed.
+typedef struct {
+    const char *buf;
+    size_t len;
+} strv_t;
+
 // checks if string 's' is valid
 bool str_ok(str_t s);
 bool str_eq(str_t s1, str_t s2);
@@ -69,6 +77,9 @@ str_t *str_cat(str_t *dest, str_t src);
 void str_cpy_fmt(str_t *dest, const char *fmt, ...);
 void str_cat_fmt(str_t *dest, const char *fmt, ...);
 
+// copies the characters of view 'src' into 'dest'
+str_t *str_cpy_v(str_t *dest, strv_t src);
+
 // reads a token into valid string 'token', from s, using delim characters as a generalisation for
 // white spaces. returns tail pointer on success, otherwise NULL (no more tokens to read).
 const char *str_tok(const char *s, str_t *token, const char *delim);
@@ -80,6 +91,18 @@ const char *str_tok_esc(const char *s, str_t *token, char delim, char esc);
 //If s starts with prefix, return the tail (from s = prefix + tail), otherwise return NULL.
 const char *str_prefix(const char *s, const char *prefix);
 
+// Same as str_tok(), but 'token' is a view of s, so nothing is copied
+const char *strv_tok(const char *s, strv_t *token, const char *delim);
+
+// view of a string, of a C-string, and comparison with a C-string
+strv_t str_view(str_t s);
+strv_t strv_ref(const char *s);
+bool strv_eq_c(strv_t sv, const char *s);
+
+// Parse a number at the start of the view (same as atoll() and atof(), but bounded by sv.len)
+int64_t strv_to_int(strv_t sv);
+double strv_to_double(strv_t sv);
+
 // reads a line from file 'in', into valid string 'out', and return the number of characters read
 // (including the '\n' if any). The '\n' is discarded from the output, but still counted.
 size_t str_getline(str_t *out, FILE *in);
@@ -12,6 +12,7 @@
  * You should have received a copy of the GNU General Public License along with this program. If
  * not, see <http://www.gnu.org/licenses/>.
 */
+#include "memstats.h"
 #include "vec.h"
 
 vec_t *vec_ptr(void *v)
@@ -30,9 +31,25 @@ void *vec_do_init(size_t capacity, size_t esize)
     vec_t *p = malloc(sizeof(vec_t) + capacity * esize);
     p->capacity = capacity;
     p->size = 0;
+    p->esize = esize;
+    p->tag = MemStats ? memstats_tag() : -1;  // not accounted if created while disabled
+
+    if (p->tag >= 0)
+        memstats_update(p->tag, (int64_t)(sizeof(vec_t) + capacity * esize), true);
+
     return (void *)p->buf;
 }
 
+void vec_do_destroy(void *v)
+{
+    vec_t *p = vec_ptr(v);
+
+    if (p->tag >= 0)
+        memstats_update(p->tag, -(int64_t)(sizeof(vec_t) + p->capacity * p->esize), false);
+
+    free(p);
+}
+
 size_t vec_size(const void *v)
 {
     return v ? vec_cptr(v)->size : 0;
@@ -65,6 +82,9 @@ void *vec_do_grow(void *v, size_t esize, size_t additional)
     }
 
     if (n > p->capacity) {
+        if (p->tag >= 0)
+            memstats_update(p->tag, (int64_t)((n - p->capacity) * esize), true);
+
         p = realloc(p, sizeof(vec_t) + esize * n);
         p->capacity = n;
     }
@@ -20,6 +20,9 @@
 typedef struct {
     size_t capacity;
     size_t size;
+    size_t esize;  // element size (for memory accounting)
+    int tag;  // subsystem charged for the memory, -1 if not accounted (see memstats.h)
+    char pad[4];
     char buf[];
 } vec_t;
 
@@ -30,8 +33,10 @@ void *vec_do_init(size_t capacity, size_t esize);
 #define vec_init(etype) vec_do_init(0, sizeof(etype))
 #define vec_init_reserve(capacity, etype) vec_do_init(capacity, sizeof(etype))
 
+void vec_do_destroy(void *v);
+
 #define vec_destroy(v) ({ \
-    if (v) free(vec_ptr(v)); \
+    if (v) vec_do_destroy(v); \
     v = NULL; \
 })
 
@@ -66,9 +66,10 @@ int64_t deadline_overdue(Worker *w)
         return 0;
 }
 
-Worker worker_init(int i, const char *logName)
+Worker worker_init(int i, const char *logName, FILE *out)
 {
     Worker w = {0};
+    w.out = out;
     w.seed = (uint64_t)i;
     w.id = i + 1;
     pthread_mutex_init(&w.deadline.mtx, NULL);
@@ -92,3 +93,24 @@ void worker_destroy(Worker *w)
         w->log = NULL;
     }
 }
+
+static struct {
+    pthread_mutex_t mtx;
+    int count;
+    char pad[4];
+} Busy = {.mtx = PTHREAD_MUTEX_INITIALIZER};  // number of workers playing a game
+
+void workers_busy_add(int n)
+{
+    pthread_mutex_lock(&Busy.mtx);
+    Busy.count += n;
+    pthread_mutex_unlock(&Busy.mtx);
+}
+
+int workers_busy_count(void)
+{
+    pthread_mutex_lock(&Busy.mtx);
+    const int count = Busy.count;
+    pthread_mutex_unlock(&Busy.mtx);
+    return count;
+}
@@ -37,14 +37,15 @@ typedef struct {
         char pad[7];
     } deadline;
     FILE *log;
+    FILE *out;  // console messages (warnings): stdout, or stderr in the library
     uint64_t seed;  // seed for prng()
     int id;  // starts at 1 (0 is for main thread)
-    char pad[4];
+    int node;  // NUMA node (and job group), 0 if NUMA is disabled
 } Worker;
 
 extern Worker *Workers;
 
-Worker worker_init(int id, const char *logName);
+Worker worker_init(int id, const char *logName, FILE *out);
 void worker_destroy(Worker *w);
 
 void deadline_set(Worker *w, const char *engineName, int64_t timeLimit);
@@ -0,0 +1,335 @@
+/*
+ * c-chess-cli, a command line interface for UCI chess engines. Copyright 2020 lucasart.
+ *
+ * c-chess-cli is free software: you can redistribute it and/or modify it under the terms of the GNU
+ * General Public License as published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * c-chess-cli is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without
+ * even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this program. If
+ * not, see <http://www.gnu.org/licenses/>.
+*/
+// Stand alone program: check heap, hmap and ring against brute force implementations, and time them
+// against the vec code they replace (sorted insertion, linear scan, memmove of the front)
+#include <string.h>
+#include <time.h>
+#include "heap.h"
+#include "hmap.h"
+#include "ring.h"
+#include "util.h"
+#include "vec.h"
+
+#define CHECK(cond) ({ \
+    if (!(cond)) \
+        DIE("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+})
+
+static double elapsed(const struct timespec *start)
+// Seconds since start
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + 1e-9 * (double)(now.tv_nsec - start->tv_nsec);
+}
+
+static int cmp_size(const void *a, const void *b)
+{
+    const size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    uint64_t key;
+    int value;
+    char pad[4];
+} Entry;
+
+static void test_hmap(uint64_t *seed)
+// Random insertions and erasures on a small key space (long clusters, many backward shifts), checked
+// against arrays indexed by key. Keys are multiples of 'stride' to also try non random hashes.
+{
+    enum {KEYS = 500, OPS = 200000};
+
+    for (uint64_t stride = 1; stride <= 1024; stride *= 32) {
+        Entry *h = hmap_init(Entry);
+        int value[KEYS] = {0};  // 0 if not in the map
+        size_t size = 0;
+
+        for (int op = 1; op <= OPS; op++) {
+            const size_t k = prng(seed) % KEYS;
+
+            if (prng(seed) % 3 == 0) {
+                CHECK(hmap_erase(h, k * stride) == (value[k] != 0));
+                size -= value[k] != 0;
+                value[k] = 0;
+            } else {
+                Entry *e = hmap_insert(h, k * stride);
+                CHECK(e->key == k * stride && e->value == value[k]);
+                size += !value[k];
+                e->value = value[k] = op;
+            }
+
+            CHECK(hmap_size(h) == size);
+
+            // Every key must remain reachable from its home slot after erasures
+            if (op % 1000 == 0)
+                for (size_t i = 0; i < KEYS; i++) {
+                    const Entry *e = hmap_find(h, i * stride);
+                    CHECK(value[i] ? e && e->value == value[i] : !e);
+                }
+        }
+
+        hmap_destroy(h);
+    }
+
+    puts("hmap: ok");
+}
+
+static void test_heap(uint64_t *seed)
+// Interleaved pushes and pops: each pop must return the smallest element pushed and not popped yet
+{
+    enum {VALUES = 1000, OPS = 200000};
+
+    size_t *h = vec_init(size_t);
+    size_t count[VALUES] = {0};  // number of copies of each value in the heap
+
+    for (int op = 0; op < OPS; op++) {
+        if (vec_size(h) && prng(seed) % 2) {
+            const size_t top = heap_pop(h, cmp_size);
+            CHECK(count[top]);
+
+            for (size_t v = 0; v < top; v++)
+                CHECK(!count[v]);
+
+            count[top]--;
+        } else {
+            const size_t v = prng(seed) % VALUES;
+            heap_push(h, v, cmp_size);
+            count[v]++;
+        }
+    }
+
+    // Drain: non decreasing order
+    for (size_t prev = 0; vec_size(h); ) {
+        const size_t top = heap_pop(h, cmp_size);
+        CHECK(top >= prev && count[top]--);
+        prev = top;
+    }
+
+    vec_destroy(h);
+    puts("heap: ok");
+}
+
+static void test_ring(uint64_t *seed)
+// Random pushes, pops and removals (wrapping around many times), checked against a vec
+{
+    enum {CAPACITY = 7, OPS = 200000};
+
+    int *r = ring_init(CAPACITY, int), *v = vec_init(int);
+    int next = 0;
+
+    for (int op = 0; op < OPS; op++) {
+        const uint64_t action = prng(seed) % 4;
+
+        if (action <= 1 && vec_size(v) < CAPACITY) {
+            ring_push(r, next);
+            vec_push(v, next);
+            next++;
+        } else if (action == 2 && vec_size(v)) {
+            CHECK(ring_pop(r) == v[0]);
+            memmove(&v[0], &v[1], (vec_size(v) - 1) * sizeof(int));
+            vec_pop(v);
+        } else if (action == 3 && vec_size(v)) {
+            const size_t i = prng(seed) % vec_size(v);
+            ring_remove(r, i);
+            memmove(&v[i], &v[i + 1], (vec_size(v) - i - 1) * sizeof(int));
+            vec_pop(v);
+        }
+
+        CHECK(ring_size(r) == vec_size(v));
+
+        for (size_t i = 0; i < vec_size(v); i++)
+            CHECK(ring_at(r, i) == v[i]);
+    }
+
+    ring_destroy(r);
+    vec_destroy(v);
+    puts("ring: ok");
+}
+
+static void bench_hmap(void)
+// Pending pairs: 'pending' games whose pair is not completed, each looked up and erased by its pair
+// index, then replaced by a new one. JobQueue keeps the linear scan: it has about -concurrency of
+// them, where the scan is faster.
+{
+    enum {OPS = 1000000};
+
+    for (size_t pending = 16; pending <= 1024; pending *= 8) {
+        struct timespec start;
+        uint64_t sum = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Entry *v = vec_init(Entry);
+
+        for (uint64_t k = 0; k < pending; k++)
+            vec_push(v, ((Entry){.key = k}));
+
+        for (uint64_t k = 0; k < OPS; k++) {
+            size_t i = 0;
+
+            while (v[i].key != k)
+                i++;
+
+            sum += v[i].key;
+            v[i] = v[vec_size(v) - 1];
+            vec_pop(v);
+            vec_push(v, ((Entry){.key = k + pending}));
+        }
+
+        vec_destroy(v);
+        const double scan = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Entry *h = hmap_init(Entry);
+
+        for (uint64_t k = 0; k < pending; k++)
+            hmap_insert(h, k);
+
+        for (uint64_t k = 0; k < OPS; k++) {
+            sum -= hmap_find(h, k)->key;
+            hmap_erase(h, k);
+            hmap_insert(h, k + pending);
+        }
+
+        hmap_destroy(h);
+        CHECK(!sum);
+        printf("hmap: %zu pending, vec scan %.3fs, hmap %.3fs\n", pending, scan, elapsed(&start));
+    }
+}
+
+static void bench_heap(uint64_t *seed)
+// Ordered backlog: games complete out of order (within a window), and are written in order once the
+// next expected one arrives. SeqWriter keeps sorted insertion with memmove: its window is about
+// -concurrency, where it is faster.
+{
+    enum {OPS = 200000};
+
+    for (size_t window = 16; window <= 1024; window *= 8) {
+        // Completion order: idx shuffled within consecutive blocks of 'window'
+        size_t *order = vec_init_reserve(OPS, size_t);
+
+        for (size_t i = 0; i < OPS; i++)
+            vec_push(order, i);
+
+        for (size_t i = 0; i < OPS; i++) {
+            const size_t block = i - i % window, n = min((size_t)window, OPS - block);
+            const size_t j = block + prng(seed) % n;
+            swap(order[i], order[j]);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t *v = vec_init(size_t), next = 0;
+
+        for (size_t i = 0; i < OPS; i++) {
+            const size_t n = vec_size(v);
+            vec_push(v, order[i]);
+
+            for (size_t k = 0; k < n; k++)
+                if (v[k] > order[i]) {
+                    memmove(&v[k + 1], &v[k], (n - k) * sizeof(size_t));
+                    v[k] = order[i];
+                    break;
+                }
+
+            size_t k = 0;
+
+            while (k < vec_size(v) && v[k] == next + k)
+                k++;
+
+            memmove(&v[0], &v[k], (vec_size(v) - k) * sizeof(size_t));
+            vec_ptr(v)->size -= k;
+            next += k;
+        }
+
+        CHECK(next == OPS);
+        vec_destroy(v);
+        const double sorted = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t *h = vec_init(size_t);
+        next = 0;
+
+        for (size_t i = 0; i < OPS; i++) {
+            heap_push(h, order[i], cmp_size);
+
+            while (vec_size(h) && h[0] == next) {
+                heap_pop(h, cmp_size);
+                next++;
+            }
+        }
+
+        CHECK(next == OPS);
+        vec_destroy(h);
+        vec_destroy(order);
+        printf("heap: window %zu, sorted vec %.3fs, heap %.3fs\n", window, sorted, elapsed(&start));
+    }
+}
+
+static void bench_ring(void)
+// Adjudicator queue: FIFO of requests, at most one per worker (memmove of the front before)
+{
+    enum {OPS = 1000000};
+
+    for (size_t capacity = 16; capacity <= 1024; capacity *= 8) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int *v = vec_init(int);
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < capacity; i++)
+            vec_push(v, (int)i);
+
+        for (int i = 0; i < OPS; i++) {
+            sum += v[0];
+            memmove(&v[0], &v[1], (vec_size(v) - 1) * sizeof(int));
+            vec_pop(v);
+            vec_push(v, i);
+        }
+
+        vec_destroy(v);
+        const double moved = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int *r = ring_init(capacity, int);
+
+        for (size_t i = 0; i < capacity; i++)
+            ring_push(r, (int)i);
+
+        for (int i = 0; i < OPS; i++) {
+            sum -= ring_pop(r);
+            ring_push(r, i);
+        }
+
+        ring_destroy(r);
+        CHECK(!sum);
+        printf("ring: capacity %zu, vec memmove %.3fs, ring %.3fs\n", capacity, moved,
+            elapsed(&start));
+    }
+}
+
+int main(void)
+{
+    uint64_t seed = 0;
+
+    test_hmap(&seed);
+    test_heap(&seed);
+    test_ring(&seed);
+
+    bench_hmap();
+    bench_heap(&seed);
+    bench_ring();
+}
@@ -27,31 +27,35 @@ typedef struct {
 
 static void parse_position(const char *tail, Position *pos, bool uciChess960)
 {
-    scope(str_destroy) str_t token = str_init();
-    tail = str_tok(tail, &token, " ");
+    strv_t token;  // view of the position command
+    tail = strv_tok(tail, &token, " ");
     assert(tail);
 
-    if (!strcmp(token.buf, "startpos")) {
+    if (strv_eq_c(token, "startpos")) {
         pos_set(pos, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", uciChess960, NULL);
-        tail = str_tok(tail, &token, " ");
-    } else if (!strcmp(token.buf, "fen")) {
-        scope(str_destroy) str_t fen = str_init();
+        tail = strv_tok(tail, &token, " ");
+    } else if (strv_eq_c(token, "fen")) {
+        // The FEN is everything up to "moves" (if any): copy it once, rather than token by token
+        const char *start = tail;
+
+        while ((tail = strv_tok(tail, &token, " ")) && !strv_eq_c(token, "moves"));
 
-        while ((tail = str_tok(tail, &token, " ")) && strcmp(token.buf, "moves"))
-            str_push(str_cat(&fen, token), ' ');
+        // token.buf: start of "moves", or end of the string
+        scope(str_destroy) str_t fen = str_init();
+        str_cpy_v(&fen, (strv_t){.buf = start, .len = (size_t)(token.buf - start)});
 
         if (!pos_set(pos, fen.buf, uciChess960, NULL))
             DIE("Illegal FEN '%s'\n", fen.buf);
     } else
         assert(false);
 
-    if (!strcmp(token.buf, "moves")) {
+    if (strv_eq_c(token, "moves")) {
         Position p[2];
         int idx = 0;
         p[0] = *pos;
 
-        while ((tail = str_tok(tail, &token, " "))) {
-            const move_t m = pos_lan_to_move(&p[idx], token.buf);
+        while ((tail = strv_tok(tail, &token, " "))) {
+            const move_t m = pos_lan_to_move(&p[idx], token);
             pos_move(&p[1 - idx], &p[idx], m);
             idx = 1 - idx;
         }
@@ -96,9 +100,9 @@ static void run_go(const Position *pos, const Go *go, uint64_t *seed)
             pv.buf);
     }
 
-    scope(str_destroy) str_t token = str_init();
-    str_tok(pv.buf, &token, " ");
-    uci_printf("bestmove %s\n", token.buf);
+    strv_t token;
+    strv_tok(pv.buf, &token, " ");
+    uci_printf("bestmove %.*s\n", (int)token.len, token.buf);
 }
 
 int main(int argc, char **argv)